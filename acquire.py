@@ -0,0 +1,153 @@
+# -*- coding: utf-8 -*-
+"""
+Live acquisition: a sample source feeding a preallocated ring buffer.
+
+The acquisition thread only ever copies blocks into the ring; it never waits
+on a consumer. Consumers (display, recorder, triggers ...) each keep their
+own absolute read position and find out from read() if they fell so far
+behind that the ring overwrote samples they had not read yet.
+"""
+
+import time
+from threading import Event, Lock, Thread
+
+import numpy as np
+
+
+class RingBuffer:
+    """Single producer, many consumer sample ring addressed by absolute index"""
+
+    def __init__(self, capacity, dtype='uint16', buf=None, head=0):
+        self.capacity = int(capacity)
+        # buf lets the ring live in a preallocated memmap instead of RAM
+        self.buf = np.zeros(self.capacity, dtype) if buf is None else buf
+        self.head = head  # absolute index of the next sample to be written
+        self.writing = head  # end of the write in progress; head once it is done
+        self.floor = head  # nothing before this index was ever written
+        self.lock = Lock()
+
+    @property
+    def dtype(self):
+        return self.buf.dtype
+
+    def write(self, block):
+        """Append a block; overwrites the oldest samples, never blocks"""
+        n = len(block)
+        if n > self.capacity:
+            block = block[-self.capacity:]
+        # announce the range about to be overwritten before touching it, so a
+        # reader copying from there finds out afterwards
+        with self.lock:
+            self.writing = self.head + n
+        start = (self.head + n - len(block)) % self.capacity
+        first = min(len(block), self.capacity - start)
+        self.buf[start:start + first] = block[:first]
+        self.buf[:len(block) - first] = block[first:]
+        # publish only after the copy so readers never see a half written block
+        with self.lock:
+            self.head += n
+
+    def skip(self, n):
+        """Advance past n samples that will never be written"""
+        with self.lock:
+            self.head += n
+            self.writing = self.floor = self.head
+
+    def oldest(self):
+        """Absolute index of the oldest sample still held (and not being overwritten)"""
+        return max(self.writing - self.capacity, self.floor)
+
+    def _copy(self, pos, n):
+        start = pos % self.capacity
+        first = min(n, self.capacity - start)
+        return np.concatenate((self.buf[start:start + first], self.buf[:n - first]))
+
+    def read(self, pos, n=None):
+        """(samples, next pos, samples lost) for the range [pos, pos + n)"""
+        head = self.head
+        lost = max(0, self.oldest() - pos)
+        pos += lost
+        n = head - pos if n is None else min(n - lost, head - pos)
+        data = self._copy(pos, n) if n > 0 else self.buf[:0].copy()
+        # the producer may have lapped us during the copy, or be overwriting
+        # part of it right now; drop all of that
+        torn = min(max(0, self.writing - self.capacity - pos), len(data))
+        if torn:
+            data = data[torn:]
+            lost += torn
+            pos += torn
+        return data, pos + len(data), lost
+
+    def latest(self, n):
+        """The most recent n samples (fewer right after start)"""
+        head = self.head
+        n = min(n, head - self.oldest())
+        return self.read(head - n, n)[0]
+
+
+def follow(ring, pos, stopping, block=1 << 16, idle=0.002):
+    """Yield (start index, samples, lost) from ring as they arrive until stopping is set"""
+    while not stopping.is_set():
+        data, nxt, lost = ring.read(pos, block)
+        if len(data) or lost:
+            yield nxt - len(data), data, lost
+        else:
+            time.sleep(idle)
+        pos = nxt
+
+
+class ReplaySource:
+    """Plays a loaded capture back in real time, looping, as a live source"""
+
+    def __init__(self, samples, rate, block=4096):
+        self.samples = np.asarray(samples)
+        self.rate = rate
+        self.block = block
+
+    def __iter__(self):
+        pos = 0
+        t0 = time.perf_counter()
+        sent = 0
+        while len(self.samples):
+            end = min(pos + self.block, len(self.samples))
+            yield self.samples[pos:end]
+            sent += end - pos
+            pos = 0 if end == len(self.samples) else end
+            ahead = sent / self.rate - (time.perf_counter() - t0)
+            if ahead > 0:
+                time.sleep(ahead)
+
+
+class Acquisition:
+    """Thread pumping a source into a ring buffer"""
+
+    def __init__(self, source, ring, rate):
+        self.source = source
+        self.ring = ring
+        self.rate = rate
+        self.start_time = None
+        self.stopping = Event()
+        self.error = None
+        self.thread = Thread(target=self._run, daemon=True)
+
+    def _run(self):
+        try:
+            for block in self.source:
+                if self.stopping.is_set():
+                    break
+                self.ring.write(block)
+        except Exception as e:
+            self.error = e
+
+    def start(self):
+        self.start_time = time.time()
+        self.thread.start()
+        return self
+
+    def stop(self):
+        self.stopping.set()
+        self.thread.join()
+
+    def time_of(self, index):
+        """Absolute time of absolute sample index"""
+        return self.start_time + index / self.rate
@@ -0,0 +1,124 @@
+# -*- coding: utf-8 -*-
+"""
+ADC characterization from a captured sine wave.
+
+FFT metrics (SNR, SINAD, ENOB, SFDR, THD with harmonic identification) use a
+rectangular window when the record holds a whole number of cycles (coherent
+sampling) and a 4-term Blackman-Harris window otherwise. The histogram (code
+density) method gives DNL and INL; code counts are accumulated in parallel
+over chunks of the capture.
+"""
+
+import numpy as np
+
+from workers import WORKERS, map_chunks
+
+HARMONICS = 10
+MAX_CODES = 1 << 20  # widest code range histogrammed, one int64 count each per worker
+
+
+def blackman_harris(n):
+    k = 2 * np.pi * np.arange(n) / n
+    return 0.35875 - 0.48829 * np.cos(k) + 0.14128 * np.cos(2 * k) - 0.01168 * np.cos(3 * k)
+
+
+def _fold(f, n):
+    # alias bin f of an n-point FFT into 0 .. n/2
+    f = f % n
+    return n - f if f > n / 2 else f
+
+
+def spectrum_metrics(samples, rate, harmonics=HARMONICS, coherent=None):
+    """SNR, SINAD, ENOB, SFDR, THD (dB) and the harmonic table of a sine capture"""
+    x = np.asarray(samples, np.float64)
+    x = x - x.mean()
+    n = len(x)
+    p = np.abs(np.fft.rfft(x)) ** 2
+    p[0] = 0
+    peak = int(np.argmax(p))
+    if coherent is None:
+        # coherent when the neighbouring bins show no leakage
+        coherent = max(p[peak - 1], p[min(peak + 1, len(p) - 1)]) < 1e-6 * p[peak]
+    if not coherent:
+        p = np.abs(np.fft.rfft(x * blackman_harris(n))) ** 2
+        p[0] = 0
+        peak = int(np.argmax(p))
+    lobe = 0 if coherent else 4
+    used = np.zeros(len(p), bool)
+    used[:lobe + 1] = True  # DC and its window skirt
+
+    def take(center):
+        lo, hi = max(int(round(center)) - lobe, 0), min(int(round(center)) + lobe + 1, len(p))
+        band = ~used[lo:hi]
+        power = p[lo:hi][band].sum()
+        used[lo:hi] = True
+        return power
+
+    lo, hi = max(peak - lobe, 1), min(peak + lobe + 1, len(p))
+    fbin = np.sum(np.arange(lo, hi) * p[lo:hi]) / np.sum(p[lo:hi])  # power centroid
+    fund = take(peak)
+    table = []
+    for h in range(2, harmonics + 1):
+        b = _fold(h * fbin, n)
+        if round(b) >= len(p) or used[int(round(b))]:
+            continue
+        power = take(b)
+        table.append((h, b * rate / n, 10 * np.log10(power / fund + 1e-300)))
+    harm = sum(10 ** (d / 10) for _, _, d in table) * fund
+    noise = p[~used].sum()
+    # harmonics count with their whole window lobe, other spurs bin by bin
+    spur = max([10 ** (d / 10) * fund for _, _, d in table] + [p[~used].max() if (~used).any() else 0])
+    sinad = 10 * np.log10(fund / (noise + harm))
+    return {
+        'frequency': fbin * rate / n,
+        'coherent': bool(coherent),
+        'snr': 10 * np.log10(fund / noise),
+        'sinad': sinad,
+        'enob': (sinad - 1.76) / 6.02,
+        'thd': 10 * np.log10(harm / fund) if harm else -np.inf,
+        'sfdr': 10 * np.log10(fund / spur) if spur > 0 else np.inf,
+        'harmonics': table,
+        'spectrum_db': 10 * np.log10(p / fund + 1e-300),
+    }
+
+
+def code_histogram(samples, chunk=1 << 22):
+    """(first code, counts per code from there) accumulated in parallel
+
+    Each worker sums its share into one array of counts, so memory is
+    workers x code range whatever the capture length; ranges wider than
+    MAX_CODES are refused.
+    """
+    lo = min(map_chunks(lambda s, e: int(np.min(samples[s:e])), len(samples), chunk))
+    hi = max(map_chunks(lambda s, e: int(np.max(samples[s:e])), len(samples), chunk))
+    width = hi - lo + 1
+    if width > MAX_CODES:
+        raise ValueError("codes span %d values, more than the %d a code histogram holds" % (width, MAX_CODES))
+
+    def work(s, e):
+        counts = np.zeros(width, np.int64)
+        for a in range(s, e, chunk):
+            counts += np.bincount(np.asarray(samples[a:min(a + chunk, e)], np.int64) - lo, minlength=width)
+        return counts
+
+    return lo, np.sum(map_chunks(work, len(samples), -(-len(samples) // WORKERS)), axis=0)
+
+
+def linearity(samples):
+    """Sine-histogram DNL and INL (LSB) per code, plus the missing codes
+
+    The end codes collect any clipping, so they are left out; transition
+    levels follow from the cumulative histogram through the sine's inverse
+    CDF, and code widths are normalised to their mean.
+    """
+    lo, counts = code_histogram(samples)
+    if len(counts) < 4:
+        return None
+    cum = np.cumsum(counts) / counts.sum()
+    transitions = -np.cos(np.pi * cum[:-1])  # upper edge of codes lo .. hi-1
+    widths = np.diff(transitions)  # codes lo+1 .. hi-1
+    dnl = widths / widths.mean() - 1
+    inl = np.cumsum(dnl)
+    inl -= np.linspace(inl[0], inl[-1], len(inl))  # end-point fit
+    codes = np.arange(lo + 1, lo + 1 + len(dnl))
+    return {'codes': codes, 'dnl': dnl, 'inl': inl, 'missing': codes[dnl <= -0.9]}
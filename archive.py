@@ -0,0 +1,271 @@
+# -*- coding: utf-8 -*-
+"""
+Deduplicating capture archive.
+
+Captures are cut into content-defined chunks: a rolling sum of per-word gear
+values over WINDOW words marks a cut wherever its low bits are zero, so the
+same stretch of signal (idle line, repeated frame) is cut the same way
+wherever it appears. Each chunk is named by its blake2b digest and stored
+once, zlib-compressed, under chunks/; a capture is a small JSON manifest
+(SUFFIX) listing its chunk digests. Hashing and compression run on worker
+threads (both release the GIL).
+
+A manifest reads back through VirtualCapture, a seekable file presenting the
+chunks as a binary capture, or through read() for a sample range. load()
+rebuilds the capture into cache/ once and memory maps it, so the rest of the
+program sees an ordinary binary capture.
+"""
+
+import hashlib
+import io
+import json
+import os
+import pathlib
+import zlib
+from collections import OrderedDict
+
+import numpy as np
+
+import capture
+from workers import map_chunks
+
+SUFFIX = '.psarc'
+VERSION = 1
+WINDOW = 32  # words in the rolling sum
+MASK = (1 << 14) - 1  # about one cut per 16K words
+MIN_CHUNK = 1 << 12  # words
+MAX_CHUNK = 1 << 17
+LEVEL = 6
+GEAR = np.random.default_rng(0x50534152).integers(0, 1 << 63, 1 << 16, dtype=np.uint64)
+
+
+def _words(samples):
+    samples = np.ascontiguousarray(samples, np.dtype(samples.dtype).newbyteorder('<'))
+    return samples.view(np.uint16), samples.dtype.itemsize // 2
+
+
+def cuts(samples):
+    """Sample indices where chunks end, the last being len(samples)"""
+    words, step = _words(samples)
+    n = len(words)
+
+    def candidates(s, e):
+        a = max(s - WINDOW + 1, 0)
+        total = np.concatenate((np.zeros(1, np.uint64), np.cumsum(GEAR[words[a:e]])))  # wraps mod 2**64
+        end = np.arange(max(s, WINDOW - 1), e)  # last word of each full window
+        rolling = total[end - a + 1] - total[end - a + 1 - WINDOW]
+        hit = end[(rolling & np.uint64(MASK)) == 0] + 1
+        return hit[hit % step == 0]
+
+    found = map_chunks(candidates, n)
+    out = []
+    last = 0
+    for p in (np.concatenate(found) if found else []):
+        while p - last > MAX_CHUNK:
+            last += MAX_CHUNK
+            out.append(last)
+        if p - last >= MIN_CHUNK:
+            out.append(p)
+            last = p
+    while n - last > MAX_CHUNK:
+        last += MAX_CHUNK
+        out.append(last)
+    if n > last:
+        out.append(n)
+    return [int(c) // step for c in out]
+
+
+def digest(data):
+    return hashlib.blake2b(data, digest_size=16).hexdigest()
+
+
+class Archive:
+    """Chunk store in directory/chunks with manifests beside it"""
+
+    def __init__(self, directory):
+        self.directory = pathlib.Path(directory)
+        self.chunks = self.directory / 'chunks'
+        self.cache = self.directory / 'cache'
+
+    def chunk_path(self, name):
+        return self.chunks / name[:2] / name
+
+    def put(self, name, samples, rate, start=0.0):
+        """Archive samples as name + SUFFIX; returns (path, stats)"""
+        samples = np.ascontiguousarray(samples, np.dtype(samples.dtype).newbyteorder('<'))
+        ends = cuts(samples)
+        bounds = list(zip([0] + ends[:-1], ends))
+
+        def hash_part(a, b):
+            return [digest(memoryview(samples[s:e]).cast('B')) for s, e in bounds[a:b]]
+
+        names = [d for part in map_chunks(hash_part, len(bounds), 64) for d in part]
+        first = {}
+        for k, d in enumerate(names):
+            first.setdefault(d, k)
+        new = [(d, k) for d, k in first.items() if not self.chunk_path(d).exists()]
+
+        def store(a, b):
+            written = 0
+            for d, k in new[a:b]:
+                s, e = bounds[k]
+                path = self.chunk_path(d)
+                path.parent.mkdir(parents=True, exist_ok=True)
+                tmp = path.with_suffix('.tmp%d' % os.getpid())
+                tmp.write_bytes(zlib.compress(memoryview(samples[s:e]).cast('B'), LEVEL))
+                os.replace(tmp, path)
+                written += path.stat().st_size
+            return written
+
+        stored = sum(map_chunks(store, len(new), 16))
+        manifest = {'version': VERSION, 'dtype': samples.dtype.name, 'rate': rate, 'start': start,
+                    'count': len(samples), 'chunks': [[d, e - s] for d, (s, e) in zip(names, bounds)]}
+        path = self.directory / (name + SUFFIX)
+        self.directory.mkdir(parents=True, exist_ok=True)
+        path.write_text(json.dumps(manifest))
+        stats = {'bytes': samples.nbytes, 'chunks': len(names), 'unique': len(first),
+                 'new': len(new), 'stored': stored}
+        return path, stats
+
+    def manifests(self):
+        return sorted(self.directory.glob('*' + SUFFIX))
+
+    def prune(self):
+        """Delete chunks no manifest refers to; returns how many went"""
+        used = {d for m in self.manifests() for d, _ in read_manifest(m)['chunks']}
+        gone = 0
+        for path in self.chunks.glob('*/*'):
+            if path.name not in used:
+                path.unlink()
+                gone += 1
+        return gone
+
+
+def read_manifest(path):
+    manifest = json.loads(pathlib.Path(path).read_text())
+    if manifest.get('version') != VERSION:
+        raise ValueError("%s: archive format version %s not supported" % (path, manifest.get('version')))
+    return manifest
+
+
+class VirtualCapture(io.RawIOBase):
+    """An archived capture as a seekable, read-only binary capture file"""
+
+    def __init__(self, path, keep=8):
+        self.path = pathlib.Path(path)
+        self.manifest = m = read_manifest(path)
+        self.store = Archive(self.path.parent)
+        self.dtype = np.dtype(m['dtype']).newbyteorder('<')
+        self.rate, self.start, self.count = m['rate'], m['start'], m['count']
+        self.names = [d for d, _ in m['chunks']]
+        self.ends = np.cumsum([c for _, c in m['chunks']], dtype=np.int64)
+        self.header = capture.pack_header(self.dtype, self.rate, self.start)
+        self.size = len(self.header) + self.count * self.dtype.itemsize
+        self.pos = 0
+        self.keep = keep
+        self.recent = OrderedDict()
+
+    def readable(self):
+        return True
+
+    def seekable(self):
+        return True
+
+    def tell(self):
+        return self.pos
+
+    def seek(self, offset, whence=io.SEEK_SET):
+        base = {io.SEEK_SET: 0, io.SEEK_CUR: self.pos, io.SEEK_END: self.size}[whence]
+        self.pos = max(base + offset, 0)
+        return self.pos
+
+    def chunk(self, k):
+        """Inflated chunk k as bytes"""
+        data = self.recent.pop(k, None)
+        if data is None:
+            data = zlib.decompress(self.store.chunk_path(self.names[k]).read_bytes())
+        self.recent[k] = data
+        while len(self.recent) > self.keep:
+            self.recent.popitem(last=False)
+        return data
+
+    def bounds(self, k):
+        return int(self.ends[k - 1]) if k else 0, int(self.ends[k])
+
+    def readinto(self, buffer):
+        out = memoryview(buffer).cast('B')
+        done = 0
+        while done < len(out) and self.pos < self.size:
+            if self.pos < len(self.header):
+                part = self.header[self.pos:self.pos + len(out) - done]
+            else:
+                at = (self.pos - len(self.header)) // self.dtype.itemsize
+                skip = (self.pos - len(self.header)) % self.dtype.itemsize
+                k = int(np.searchsorted(self.ends, at, side='right'))
+                s, _ = self.bounds(k)
+                data = self.chunk(k)
+                a = (at - s) * self.dtype.itemsize + skip
+                part = data[a:a + len(out) - done]
+            out[done:done + len(part)] = part
+            done += len(part)
+            self.pos += len(part)
+        return done
+
+    def samples(self, start=0, stop=None):
+        """Samples [start, stop), inflating the chunks spanned in parallel"""
+        stop = self.count if stop is None else min(int(stop), self.count)
+        start = max(int(start), 0)
+        if stop <= start:
+            return np.empty(0, self.dtype)
+        k0 = int(np.searchsorted(self.ends, start, side='right'))
+        k1 = int(np.searchsorted(self.ends, stop - 1, side='right')) + 1
+
+        def inflate(a, b):
+            return [np.frombuffer(zlib.decompress(self.store.chunk_path(self.names[k]).read_bytes()), self.dtype)
+                    for k in range(k0 + a, k0 + b)]
+
+        blocks = [c for part in map_chunks(inflate, k1 - k0, 4) for c in part]
+        s, _ = self.bounds(k0)
+        return np.concatenate(blocks)[start - s:stop - s]
+
+
+def info(path):
+    """(dtype, rate, start, count) of an archived capture"""
+    m = read_manifest(path)
+    return m['dtype'], m['rate'], m['start'], m['count']
+
+
+def read(path, start=0, stop=None):
+    return VirtualCapture(path).samples(start, stop)
+
+
+def extract(path, out):
+    """Rebuild an archived capture as a binary capture at out"""
+    v = VirtualCapture(path)
+    with open(out, 'wb') as f:
+        f.write(v.header)
+        f.truncate(v.size)
+
+    def write(a, b):
+        # a handle per worker, so seek + write needs no lock (no pwrite on Windows)
+        with open(out, 'r+b') as f:
+            for k in range(a, b):
+                s, _ = v.bounds(k)
+                f.seek(len(v.header) + s * v.dtype.itemsize)
+                f.write(zlib.decompress(v.store.chunk_path(v.names[k]).read_bytes()))
+
+    map_chunks(write, len(v.names), 4)
+    return out
+
+
+def load(path):
+    """Memory map an archived capture, rebuilding it into the cache when needed"""
+    path = pathlib.Path(path)
+    key = digest(path.read_bytes())  # a new manifest gets a new cache file
+    out = Archive(path.parent).cache / ('%s-%s%s' % (path.stem, key[:12], capture.SUFFIX))
+    if not out.exists():
+        out.parent.mkdir(parents=True, exist_ok=True)
+        tmp = out.with_suffix('.tmp%d' % os.getpid())
+        extract(path, tmp)
+        os.replace(tmp, out)
+    return capture.load_binary(out)
@@ -0,0 +1,114 @@
+# -*- coding: utf-8 -*-
+"""
+Apache Arrow IPC and Parquet export/import for samples, edges and events.
+
+Numeric columns are handed to Arrow as buffers over the numpy arrays
+themselves (memory-mapped captures included), so building a table copies
+nothing; event types become a dictionary column over the store's codes.
+Arrow IPC files are read back through a memory map, so a sample column
+loads as a capture without a copy. Exports of several tables are written
+concurrently; pyarrow compresses outside the GIL.
+
+pyarrow is optional and only needed here.
+"""
+
+import pathlib
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+
+try:
+    import pyarrow as pa
+    import pyarrow.ipc as ipc
+    import pyarrow.parquet as pq
+except ImportError:
+    pa = None
+
+SUFFIXES = ('.arrow', '.feather', '.parquet')
+
+
+def _require():
+    if pa is None:
+        raise RuntimeError("Arrow/Parquet support needs pyarrow (pip install pyarrow)")
+
+
+def column(values):
+    """Arrow array over a numpy array's memory, no copy for contiguous input"""
+    _require()
+    values = np.ascontiguousarray(values)
+    return pa.Array.from_buffers(pa.from_numpy_dtype(values.dtype), len(values), [None, pa.py_buffer(values)])
+
+
+def samples_table(samples, rate=0.0, start=0.0):
+    _require()
+    meta = {'rate': repr(float(rate)), 'start': repr(float(start))}
+    return pa.table({'samples': column(samples)}).replace_schema_metadata(meta)
+
+
+def events_table(store):
+    """Every event of an EventStore, type as a dictionary column"""
+    _require()
+    q = store.query()
+    # Arrow wants signed dictionary indices
+    types = pa.DictionaryArray.from_arrays(column(q.column('type').astype(np.int32)),
+                                           pa.array(store.types, pa.string()))
+    return pa.table({'time': column(q.column('time')), 'duration': column(q.column('duration')),
+                     'type': types, 'value': column(q.column('value')), 'flags': column(q.column('flags'))})
+
+
+def edges_table(store):
+    """Edge events only: time and the new level"""
+    _require()
+    q = store.query().type('edge')
+    return pa.table({'time': column(q.column('time')), 'level': column(q.column('value'))})
+
+
+def write(path, table, compression='zstd'):
+    """Write a table as Parquet (by suffix) or Arrow IPC"""
+    _require()
+    path = pathlib.Path(path)
+    if path.suffix == '.parquet':
+        pq.write_table(table, str(path), compression=compression)
+    else:
+        options = ipc.IpcWriteOptions(compression=None if compression in (None, 'none') else compression)
+        with pa.OSFile(str(path), 'wb') as sink, ipc.new_file(sink, table.schema, options=options) as w:
+            w.write_table(table)
+    return path
+
+
+def export(base, samples=None, rate=0.0, start=0.0, store=None, suffix='.arrow', compression=None):
+    """Write base_samples, base_edges and base_events in parallel; returns the paths
+
+    Arrow IPC is left uncompressed by default so it can be memory-mapped back.
+    """
+    _require()
+    base = pathlib.Path(base)
+    jobs = []
+    if samples is not None:
+        jobs.append((base.with_name(base.stem + '_samples' + suffix), samples_table(samples, rate, start)))
+    if store is not None and len(store):
+        jobs.append((base.with_name(base.stem + '_events' + suffix), events_table(store)))
+        jobs.append((base.with_name(base.stem + '_edges' + suffix), edges_table(store)))
+    if compression is None and suffix == '.parquet':
+        compression = 'zstd'
+    with ThreadPoolExecutor(max_workers=max(len(jobs), 1)) as pool:
+        return list(pool.map(lambda job: write(job[0], job[1], compression), jobs))
+
+
+def read_table(path, columns=None):
+    """A table from Arrow IPC (memory-mapped) or Parquet"""
+    _require()
+    path = str(path)
+    if path.endswith('.parquet'):
+        return pq.read_table(path, columns=columns)
+    table = ipc.open_file(pa.memory_map(path, 'r')).read_all()
+    return table.select(columns) if columns else table
+
+
+def load(path, name='samples'):
+    """One numeric column as a sample array; zero-copy when it is one unpadded chunk"""
+    col = read_table(path, [name]).column(name)
+    if col.num_chunks == 1:
+        return col.chunk(0).to_numpy(zero_copy_only=col.null_count == 0)
+    return col.to_numpy()
+
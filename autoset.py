@@ -0,0 +1,113 @@
+# -*- coding: utf-8 -*-
+"""
+Autoset: pick vertical scale, threshold, trigger level, timebase and a
+likely baud rate from coarse statistics.
+
+Only a fixed number of evenly spread blocks of the capture are touched
+(sparse sampling), so the cost does not grow with capture length and a
+memory-mapped multi-GB capture only pages in those blocks.
+"""
+
+import numpy as np
+
+BLOCKS = 64
+BLOCK = 4096
+BAUDS = (300, 600, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400,
+         460800, 921600, 1000000, 2000000, 3000000, 4000000)
+
+
+def sparse_blocks(samples, blocks=BLOCKS, block=BLOCK):
+    """Up to blocks evenly spread contiguous slices of samples"""
+    n = len(samples)
+    if n <= blocks * block:
+        return [np.asarray(samples)]
+    starts = np.linspace(0, n - block, blocks).astype(np.int64)
+    return [np.asarray(samples[s:s + block]) for s in starts]
+
+
+def otsu(hist, centers):
+    """Threshold maximizing the between-class variance of a histogram"""
+    w = np.cumsum(hist)
+    m = np.cumsum(hist * centers)
+    total, mean = w[-1], m[-1]
+    with np.errstate(divide='ignore', invalid='ignore'):
+        between = (mean * w - m * total) ** 2 / (w * (total - w))
+    between[~np.isfinite(between)] = -1
+    return centers[int(np.argmax(between))]
+
+
+def run_lengths(logic):
+    """Lengths of the complete constant runs inside one logic block"""
+    edges = np.flatnonzero(np.diff(logic.astype(np.int8)))
+    return np.diff(edges)
+
+
+def bit_period(blocks, threshold):
+    """Estimated samples per bit from the shortest common run length"""
+    runs = np.concatenate([run_lengths(b >= threshold) for b in blocks])
+    runs = runs[runs > 1]  # single sample runs are noise
+    if len(runs) < 4:
+        return None
+    shortest = np.percentile(runs, 5)
+    near = runs[runs < 1.5 * shortest]
+    bit = float(np.median(near))
+    # refine against every run as an integer multiple of the bit
+    k = np.maximum(np.round(runs / bit), 1)
+    return float(np.sum(runs) / np.sum(k))
+
+
+def fundamental(block, decimate=4):
+    """Period in samples of the strongest repetition (autocorrelation), or None"""
+    x = block[:len(block) // decimate * decimate].astype(np.float64)
+    x = x.reshape(-1, decimate).mean(axis=1)
+    x -= x.mean()
+    if not np.any(x):
+        return None
+    spec = np.fft.rfft(x, 2 * len(x))
+    ac = np.fft.irfft(spec * np.conj(spec))[:len(x) // 2]
+    below = np.flatnonzero(ac < 0)
+    if not len(below):
+        return None
+    lag = below[0] + int(np.argmax(ac[below[0]:]))
+    if ac[lag] < 0.2 * ac[0]:
+        return None
+    return float(lag * decimate)
+
+
+def autoset(samples, rate=None):
+    """Display and trigger settings for a capture, as a dict"""
+    blocks = sparse_blocks(samples)
+    flat = np.concatenate(blocks).astype(np.float64)
+    lo, hi = np.percentile(flat, (0.1, 99.9))
+    hist, edges = np.histogram(flat, bins=256, range=(lo, hi if hi > lo else lo + 1))
+    centers = (edges[:-1] + edges[1:]) / 2
+    split = otsu(hist, centers)
+    low = float(np.median(flat[flat < split])) if np.any(flat < split) else lo
+    high = float(np.median(flat[flat >= split])) if np.any(flat >= split) else hi
+    threshold = (low + high) / 2
+    margin = 0.1 * max(hi - lo, 1)
+
+    bit = bit_period(blocks, threshold)
+    period = fundamental(max(blocks, key=len))
+    if bit and period and abs(period - 2 * bit) < 0.1 * period:
+        bit = None  # equal high and low runs: a clock or tone, not a bit stream
+    # show about 20 bits of a serial stream, or 5 periods of a repetitive signal
+    span = 20 * bit if bit else (5 * period if period else min(len(samples), BLOCK))
+
+    baud = None
+    if bit and rate:
+        baud = rate / bit
+        nearest = min(BAUDS, key=lambda b: abs(b - baud))
+        if abs(nearest - baud) < 0.03 * nearest:
+            baud = nearest
+    return {
+        'ylim': (float(lo - margin), float(hi + margin)),
+        'low': low,
+        'high': high,
+        'threshold': float(threshold),
+        'trigger': float(threshold),
+        'bit': bit,
+        'period': period,
+        'span': int(max(span, 2)),
+        'baud': baud,
+    }
@@ -0,0 +1,71 @@
+# -*- coding: utf-8 -*-
+"""
+Baseline restoration for AC-coupled inputs.
+
+The baseline is the midpoint of the running minimum and maximum over a
+centred window, which follows slow wander but not the data. Running extremes
+use the van Herk/Gil-Werman scheme: per-block prefix and suffix extremes,
+then one elementwise max/min, so the cost is O(1) per sample whatever the
+window, and each step is a whole-array numpy operation. The Restorer keeps
+just enough context to run on a stream of blocks.
+"""
+
+import numpy as np
+
+
+def running(y, w, op):
+    """op-extreme of every window y[i:i + w], i = 0 .. len(y) - w"""
+    n = len(y)
+    if n < w:
+        return np.empty(0, y.dtype)
+    blocks = -(-n // w)
+    fill = np.finfo(y.dtype).min if op is np.maximum else np.finfo(y.dtype).max
+    pad = np.full(blocks * w, fill, y.dtype)
+    pad[:n] = y
+    b = pad.reshape(blocks, w)
+    prefix = op.accumulate(b, axis=1).ravel()
+    suffix = op.accumulate(b[:, ::-1], axis=1)[:, ::-1].ravel()
+    return op(suffix[:n - w + 1], prefix[w - 1:n])
+
+
+class Restorer:
+    """Streaming x - baseline + level with a centred window of 2 * half + 1"""
+
+    def __init__(self, window=4001, level=0.0):
+        self.half = max(int(window) // 2, 1)
+        self.level = level
+        self.buf = None
+
+    def _run(self, buf):
+        w = 2 * self.half + 1
+        mid = (running(buf, w, np.maximum) + running(buf, w, np.minimum)) / 2
+        return buf[self.half:self.half + len(mid)] - mid + self.level
+
+    def feed(self, x):
+        """Restored samples for as much of the stream as has right-hand context"""
+        x = np.asarray(x, np.float32)
+        if self.buf is None:
+            if not len(x):
+                return x
+            # replicate the first sample as left context
+            self.buf = np.full(self.half, x[0], np.float32)
+        buf = np.concatenate((self.buf, x))
+        out = self._run(buf)
+        self.buf = buf[len(out):]
+        return out
+
+    def flush(self):
+        """The last half window of samples, right context replicated"""
+        if self.buf is None or len(self.buf) <= self.half:
+            return np.empty(0, np.float32)
+        buf = np.concatenate((self.buf, np.full(self.half, self.buf[-1], np.float32)))
+        self.buf = None
+        return self._run(buf)
+
+
+def restore(x, window=4001, level=0.0, block=1 << 20):
+    """Baseline-restored copy of a whole capture (float32)"""
+    r = Restorer(window, level)
+    parts = [r.feed(x[s:s + block]) for s in range(0, len(x), block)]
+    parts.append(r.flush())
+    return np.concatenate(parts)
@@ -0,0 +1,191 @@
+# -*- coding: utf-8 -*-
+"""
+Bathtub curves and BER contours from a labelled eye histogram.
+
+Every point of the eye (sampling phase, decision level) has a measured
+error rate: samples labelled 1 that fall below the level plus samples
+labelled 0 above it, over all samples at that phase. With cumulative sums
+along the level axis the whole grid comes out of the folded histogram at
+once, so nothing is re-read from the capture. Tails are extrapolated with
+the dual-Dirac model: in Q scale (Q = -inv_cdf(BER / rho)) each side of a
+bathtub is a straight line in position, fitted between the measurement
+floor and an upper BER, which gives the opening at 1e-12 and below.
+
+A clean eye folded at a few samples per UI can fall from near 0.5 to no
+errors at all within one or two phase bins. The upper BER is then widened,
+using only the points nearest the centre. Failing that, the error-free
+point next to the edge enters the fit at the floor, an upper bound on its
+BER, with the nearest failing point (at Q 0 if past WIDE), so that side's
+opening is a lower bound ('bounded'). A side that cannot be fitted at all
+leaves the opening None ('no fit').
+"""
+
+from statistics import NormalDist
+
+import numpy as np
+
+from workers import map_chunks
+
+TARGET = 1e-12
+CONTOURS = (1e-3, 1e-6, 1e-9, 1e-12)
+RHO = 0.5  # transition density
+WIDE = 0.4  # upper BER when too few points lie below top (Q needs BER < RHO)
+SPAN = 0.5  # least Q range a side is fitted over
+_NORMAL = NormalDist()
+
+
+def one_ui(eye, counts):
+    """Counts folded onto a single UI, [0, 1) with the symbol centre at 0.5"""
+    per = counts.shape[0] // eye.ui
+    return counts.reshape(eye.ui, per, counts.shape[1]).sum(axis=0)
+
+
+def ber_grid(eye):
+    """(phases in UI, levels, BER[phase, level], samples per phase) of a labelled eye"""
+    if eye.ones is None:
+        raise ValueError("the eye must be folded with a threshold to label bits")
+    total, ones = one_ui(eye, eye.hist), one_ui(eye, eye.ones)
+    zeros = total - ones
+    column = total.sum(axis=1)
+
+    def work(s, e):
+        # ones below each level boundary plus zeros at or above it
+        below = np.cumsum(ones[s:e], axis=1) - ones[s:e]
+        above = np.cumsum(zeros[s:e, ::-1], axis=1)[:, ::-1]
+        with np.errstate(invalid='ignore', divide='ignore'):
+            return (below + above) / column[s:e, None]
+
+    ber = np.concatenate(map_chunks(work, len(total), 16))
+    phases = (np.arange(len(total)) + 0.5) / len(total)
+    # with few samples per UI some phase bins never fill
+    filled = column > 0
+    return phases[filled], eye.levels[:-1], ber[filled], column[filled]
+
+
+def q_scale(ber, rho=RHO):
+    """Q of each BER under the dual-Dirac model (nan where undefined)"""
+    ber = np.asarray(ber, np.float64) / rho
+    ok = (ber > 0) & (ber < 1)
+    q = np.full(ber.shape, np.nan)
+    q[ok] = [-_NORMAL.inv_cdf(b) for b in ber[ok]]
+    return q
+
+
+def ber_of_q(q, rho=RHO):
+    return rho * np.array([_NORMAL.cdf(-v) for v in np.atleast_1d(q)])
+
+
+def _fit(pos, q):
+    if len(pos) < 2 or not np.isfinite(q).all() or np.ptp(q) < SPAN:
+        return None
+    slope, offset = np.polyfit(q, pos, 1)
+    return offset, slope
+
+
+def _side(outward, pos, ber, q, floor, top, rho):
+    """(fit, kind) of one side; outward runs from the centre to the edge"""
+    side = outward[1:]
+    for limit, grow in ((top, False), (WIDE, True)):
+        use = side[(ber[side] >= floor[side]) & (ber[side] <= limit)]
+        # widened, as few of the innermost points as span SPAN: further out
+        # ISI plateaus would bend the line
+        for n in range(2, len(use) + 1) if grow else (len(use),):
+            fit = _fit(pos[use[:n]], q[use[:n]])
+            if fit is not None:
+                return fit, 'measured'
+    edge = np.flatnonzero(ber[outward] >= floor[outward])
+    if not len(edge) or not edge[0]:
+        return None, 'no fit'
+    # the last error-free point has Q at least that of the floor, and the
+    # nearest failing one far enough below it Q at most its own (0 past WIDE,
+    # at the crossing); a line through those bounds reaches the target Q no
+    # further out than the real edge does
+    clean = outward[edge[0] - 1]
+    qc = q_scale([floor[clean]], rho)[0]
+    for fail in outward[edge[0]:]:
+        if ber[fail] < floor[fail]:
+            continue
+        fit = _fit(pos[[fail, clean]], np.array([q[fail] if ber[fail] <= WIDE else 0.0, qc]))
+        if fit is not None:
+            return fit, 'bounded'
+    return None, 'no fit'
+
+
+def bathtub(pos, ber, floor, top=1e-2, rho=RHO, target=TARGET):
+    """Dual-Dirac fit of both sides of one bathtub
+
+    pos and ber run along the sweep, floor is the smallest BER worth
+    trusting (a few errors' worth), per point or one for all. Returns the
+    centre, the (offset, slope) fits of position against Q for each side
+    (None where there is no fit), the opening at target (None unless both
+    sides fit) and how it was fitted: 'measured', 'bounded' (a lower bound)
+    or 'no fit'.
+    """
+    ber = np.nan_to_num(np.asarray(ber, np.float64), nan=1.0)
+    floor = np.broadcast_to(np.asarray(floor, np.float64), ber.shape)
+    low = np.flatnonzero(ber <= ber.min())
+    centre = int(low[len(low) // 2])
+    q = q_scale(ber, rho)
+    index = np.arange(len(ber))
+    (left, lkind), (right, rkind) = (_side(index[centre::-1], pos, ber, q, floor, top, rho),
+                                     _side(index[centre:], pos, ber, q, floor, top, rho))
+    qt = q_scale([target], rho)[0]
+    opening = None
+    if left is not None and right is not None:
+        opening = float(np.fmax((right[0] + right[1] * qt) - (left[0] + left[1] * qt), 0.0))
+    kinds = (lkind, rkind)
+    fitted = 'no fit' if 'no fit' in kinds else 'bounded' if 'bounded' in kinds else 'measured'
+    return {'centre': pos[centre], 'left': left, 'right': right, 'opening': opening, 'fit': fitted}
+
+
+def extrapolate(fit, q):
+    """Positions of a fitted side at the given Q values"""
+    return fit[0] + fit[1] * np.asarray(q)
+
+
+def centred(phases, ber, row):
+    """Column order putting the crossing at both ends of the sweep, and its phases
+
+    The fold puts the symbol centre only roughly at 0.5; the phase sweep is
+    circular, so it is cut at the crossing (worst BER at the threshold), whose
+    column is repeated one UI earlier to start the left side.
+    """
+    k = int(np.argmax(np.nan_to_num(ber[:, row], nan=0.0)))
+    order = np.concatenate(([k], np.arange(k + 1, len(phases)), np.arange(k + 1)))
+    shifted = np.concatenate(([phases[k] - 1], phases[k + 1:] - 1, phases[:k + 1]))
+    return order, shifted
+
+
+def analyze(eye, rho=RHO, target=TARGET, contours=CONTOURS, errors=10):
+    """Horizontal and vertical bathtubs plus BER contours of a labelled eye"""
+    phases, levels, ber, column = ber_grid(eye)
+    row = int(np.clip(np.searchsorted(levels, eye.threshold), 0, len(levels) - 1))
+    order, phases = centred(phases, ber, row)
+    ber, column = ber[order], column[order]
+    total = one_ui(eye, eye.hist)
+    density = total[total.sum(axis=1) > 0][order]
+    # phase bins fill unevenly when the bit period is not a whole number of samples
+    floor = errors / np.maximum(column, 1)
+    horizontal = bathtub(phases, ber[:, row], floor, rho=rho, target=target)
+    col = int(np.argmin(np.abs(phases - horizontal['centre'])))
+    vertical = bathtub(levels, ber[col], errors / max(column[col], 1), rho=rho, target=target)
+
+    qs = q_scale(contours, rho)
+
+    def work(s, e):
+        # per level row, left and right phase where each contour BER is reached
+        out = np.full((e - s, len(contours), 2), np.nan)
+        for r in range(s, e):
+            b = bathtub(phases, ber[:, r], floor, rho=rho, target=target)
+            for side, fit in enumerate((b['left'], b['right'])):
+                if fit is not None:
+                    out[r - s, :, side] = extrapolate(fit, qs)
+        return out
+
+    edges = np.concatenate(map_chunks(work, len(levels), 8))
+    # a contour is closed only where its left edge is left of its right edge
+    bad = ~(edges[..., 0] < edges[..., 1])
+    edges[bad] = np.nan
+    # row and col index the BER cuts the two bathtubs were fitted to
+    return {'phases': phases, 'levels': levels, 'ber': ber, 'density': density, 'row': row, 'col': col,
+            'horizontal': horizontal, 'vertical': vertical, 'contours': contours, 'contour_edges': edges, 'floor': floor}
@@ -0,0 +1,95 @@
+# -*- coding: utf-8 -*-
+"""
+Capture file loading shared by the GUI and command line tools.
+
+Two native formats are understood: the original text captures (one hex word
+per line) and binary captures, which are a HEADER_SIZE byte header followed
+by raw little-endian samples. The header is padded to a full page so sample
+data starts aligned and the file can be memory mapped directly. A 'samples'
+column of an Arrow or Parquet file (see arrowio) or an HDF5 'samples' dataset
+(see hdf5io) loads as a capture too, as does an archive manifest (see
+archive), which is rebuilt once into the archive's cache and mapped.
+"""
+
+import os
+import struct
+
+import numpy as np
+
+import archive
+import arrowio
+import hdf5io
+
+DTYPES = ('uint16', 'int16', 'uint32')
+
+MAGIC = b'PSCAP\0'
+VERSION = 1
+HEADER_SIZE = 4096
+# magic, version, dtype index, sample rate, absolute start time
+HEADER = struct.Struct('<6sHHdd')
+SUFFIX = '.pscap'
+
+
+def load_text(path, dtype='uint16'):
+    """Read a capture of one hex word per line into a sample buffer"""
+    # one column, so the default delimiter splits lines; newer numpy rejects '\n'
+    return np.loadtxt(path, dtype=dtype,
+                      converters={_: lambda s: np.short(int(s, 16)) for _ in range(1)}, encoding="utf8")
+
+
+def parse_lines(lines, dtype='uint16'):
+    """Convert hex text lines (str or bytes) the same way load_text does"""
+    return np.array([np.short(int(s, 16)) for s in lines]).astype(dtype)
+
+
+def pack_header(dtype, rate, start):
+    """HEADER_SIZE bytes describing a binary capture"""
+    head = HEADER.pack(MAGIC, VERSION, DTYPES.index(np.dtype(dtype).name), rate, start)
+    return head.ljust(HEADER_SIZE, b'\0')
+
+
+def read_header(path):
+    """(dtype, rate, start) of a binary capture, or None for a text capture"""
+    with open(path, 'rb') as f:
+        head = f.read(HEADER.size)
+    if len(head) < HEADER.size or not head.startswith(MAGIC):
+        return None
+    magic, version, dtype, rate, start = HEADER.unpack(head)
+    if version != VERSION:
+        raise ValueError("%s: capture format version %d not supported" % (path, version))
+    return DTYPES[dtype], rate, start
+
+
+def load_binary(path):
+    """Memory map the samples of a binary capture"""
+    dtype, rate, start = read_header(path)
+    if os.path.getsize(path) <= HEADER_SIZE:
+        return np.empty(0, dtype)  # mmap refuses an empty range
+    return np.memmap(path, dtype=np.dtype(dtype).newbyteorder('<'), mode='r', offset=HEADER_SIZE)
+
+
+def load(path, dtype='uint16'):
+    """Load any format; binary and Arrow captures carry their own dtype"""
+    if str(path).endswith(arrowio.SUFFIXES):
+        return arrowio.load(path)
+    if str(path).endswith(hdf5io.SUFFIXES):
+        return hdf5io.load(path)
+    if str(path).endswith(archive.SUFFIX):
+        return archive.load(path)
+    if read_header(path) is not None:
+        return load_binary(path)
+    return load_text(path, dtype)
+
+
+def save_binary(path, samples, rate, start):
+    """Write samples as a binary capture"""
+    samples = np.ascontiguousarray(samples, np.dtype(samples.dtype).newbyteorder('<'))
+    with open(path, 'wb') as f:
+        f.write(pack_header(samples.dtype, rate, start))
+        f.write(memoryview(samples).cast('B'))
+
+
+def channels(samples, count=2):
+    """Views of each channel of an interleaved multi-channel capture"""
+    n = len(samples) // count * count
+    return [samples[i:n:count] for i in range(count)]
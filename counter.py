@@ -0,0 +1,173 @@
+# -*- coding: utf-8 -*-
+"""
+Reciprocal frequency counter.
+
+Rising threshold crossings are timestamped with linear interpolation between
+samples. The counter re-arms only after the signal has dropped below
+threshold - hysteresis, and a crossing closer to the previous one than
+GLITCH of the median period is dropped, so noise on an edge counts once.
+Frequency comes from a least-squares line through all edge times against
+edge number, which averages the timestamp noise of every edge rather than
+only the two at the ends of a gate. Per-gate reciprocal readings feed an
+Allan deviation.
+
+Chunks are processed on the thread pool and reduced with the pairwise
+(Chan) update, so edges are never all held in memory and sums stay centered.
+"""
+
+import numpy as np
+
+from workers import CHUNK, map_chunks
+
+
+HYSTERESIS = 0.1  # of the signal swing, when none is given
+GLITCH = 0.25  # of the median period
+
+
+def edge_times(x, threshold, offset=0, hysteresis=0.0, armed=False):
+    """Interpolated sample times of the rising crossings in x
+
+    armed is the counter state before x[0]; x[0] itself is never a crossing.
+    """
+    x = np.asarray(x, dtype=np.float64)
+    idx = np.arange(len(x))
+    # index of the latest sample below the arming level / at or above the threshold
+    low = np.maximum.accumulate(np.where(x < threshold - hysteresis, idx, -2 + armed))
+    high = np.maximum.accumulate(np.where(x >= threshold, idx, -1 - armed))
+    i = np.flatnonzero((x[1:] >= threshold) & (low[:-1] > high[:-1])) + 1
+    frac = (threshold - x[i - 1]) / (x[i] - x[i - 1])
+    return offset + i - 1 + frac
+
+
+def armed_at(x, end, threshold, hysteresis=0.0, block=1 << 12):
+    """Counter state after x[:end]: armed below threshold - hysteresis until the next crossing"""
+    while end > 0:
+        seg = np.asarray(x[max(end - block, 0):end], dtype=np.float64)
+        hit = np.flatnonzero((seg < threshold - hysteresis) | (seg >= threshold))
+        if len(hit):
+            return bool(seg[hit[-1]] < threshold - hysteresis)
+        end -= block
+    return False
+
+
+def swing(samples, points=1 << 16):
+    """1st to 99th percentile span of a strided subsample"""
+    if not len(samples):
+        return 0.0
+    lo, hi = np.percentile(samples[::max(1, len(samples) // points)], (1, 99))
+    return float(hi - lo)
+
+
+def _moments(t):
+    # n, mean edge number, mean time, sum of squares (k), sum of squares (t), co-moment
+    n = len(t)
+    k = np.arange(n, dtype=np.float64)
+    kc = k - k.mean()
+    tc = t - t.mean()
+    return np.array([n, k.mean(), t.mean(), kc @ kc, tc @ tc, kc @ tc])
+
+
+def _combine(a, b, shift):
+    # Chan et al. parallel update; b's edge numbers start shift edges later
+    na, nb = a[0], b[0]
+    if nb == 0:
+        return a
+    if na == 0:
+        out = b.copy()
+        out[1] += shift
+        return out
+    n = na + nb
+    dk = b[1] + shift - a[1]
+    dt = b[2] - a[2]
+    f = na * nb / n
+    return np.array([n, a[1] + dk * nb / n, a[2] + dt * nb / n,
+                     a[3] + b[3] + dk * dk * f, a[4] + b[4] + dt * dt * f, a[5] + b[5] + dk * dt * f])
+
+
+def _gates(t, gate):
+    # per gate: index, edge count, first and last edge time
+    g = (t // gate).astype(np.int64)
+    starts = np.flatnonzero(np.r_[True, g[1:] != g[:-1]])
+    ends = np.r_[starts[1:], len(t)] - 1
+    return g[starts], ends - starts + 1, t[starts], t[ends]
+
+
+def measure(samples, threshold, rate, gate=None, nominal=None, hysteresis=None, chunk=CHUNK):
+    """Frequency, ppm error, edge jitter and Allan deviation of a capture
+
+    gate is in seconds (default: 1/100 of the capture); nominal in Hz;
+    hysteresis in sample units (default: HYSTERESIS of the swing).
+    """
+    n = len(samples)
+    gate_samples = max(2.0, (gate * rate) if gate else n / 100)
+    h = HYSTERESIS * swing(samples) if hysteresis is None else hysteresis
+
+    def crossings(a, e):
+        return edge_times(samples[a:e], threshold, a, h, armed_at(samples, a, threshold, h))
+
+    def work(s, e):
+        t = crossings(max(s - 1, 0), e)
+        if len(t) > 2:
+            gap = GLITCH * np.median(np.diff(t))
+            # the crossing before this chunk's first, if it is close enough to matter
+            before = crossings(max(int(t[0] - gap) - 1, 0), max(s, 1))
+            prev = np.r_[before[-1] if len(before) else -np.inf, t[:-1]]
+            t = t[t - prev >= gap]
+        if not len(t):
+            return np.zeros(6), (np.empty(0, np.int64), np.empty(0, np.int64), t, t)
+        return _moments(t), _gates(t, gate_samples)
+
+    parts = map_chunks(work, n, chunk)
+    total = np.zeros(6)
+    shifts = []
+    for m, _ in parts:
+        shifts.append(total[0])
+        total = _combine(total, m, total[0])
+    if total[0] < 2:
+        return None
+
+    slope = total[5] / total[3]  # samples per cycle
+    # residual about the global line, summed chunk by chunk so no large
+    # uncentered sums cancel: within-chunk scatter plus offset of chunk means
+    sse = 0.0
+    for (m, _), shift in zip(parts, shifts):
+        if m[0]:
+            fit = total[2] + slope * (m[1] + shift - total[1])
+            sse += m[4] - 2 * slope * m[5] + slope * slope * m[3] + m[0] * (m[2] - fit) ** 2
+    freq = rate / slope
+
+    # merge gates that straddle chunk boundaries
+    idx, count, first, last = (np.concatenate(c) for c in zip(*(g for _, g in parts)))
+    bounds = np.flatnonzero(np.r_[True, idx[1:] != idx[:-1]])
+    count = np.add.reduceat(count, bounds)
+    first = np.minimum.reduceat(first, bounds)
+    last = np.maximum.reduceat(last, bounds)
+    ok = (count > 1) & (last > first)
+    gate_freq = rate * (count[ok] - 1) / (last[ok] - first[ok])
+
+    result = {
+        'frequency': freq,
+        'period': slope / rate,
+        'edges': int(total[0]),
+        'jitter': np.sqrt(max(sse, 0) / max(total[0] - 2, 1)) / rate,  # rms of edge times about the fit, seconds
+        'gate': gate_samples / rate,
+        'gate_frequency': gate_freq,
+        'adev': allan(gate_freq, gate_samples / rate),
+    }
+    if nominal:
+        result['ppm'] = (freq - nominal) / nominal * 1e6
+    return result
+
+
+def allan(freq, tau0):
+    """Non-overlapping Allan deviation [(tau, adev)] of a gate frequency series"""
+    if len(freq) < 3:
+        return []
+    y = freq / np.mean(freq) - 1
+    out = []
+    m = 1
+    while len(y) // m >= 3:
+        avg = y[:len(y) // m * m].reshape(-1, m).mean(axis=1)
+        out.append((m * tau0, float(np.sqrt(0.5 * np.mean(np.diff(avg) ** 2)))))
+        m *= 2
+    return out
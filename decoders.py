@@ -0,0 +1,458 @@
+# -*- coding: utf-8 -*-
+"""
+Streaming protocol decoders and the plugin loader.
+
+A decoder consumes batches of one stream kind (raw samples, sliced logic or
+annotations) and returns a batch of its output kind. Decoders are stacked so
+that, e.g., slicer -> uart -> framing turns samples into frames. Plugins are
+shared objects implementing plugins/decoder_plugin.h, or Python modules
+exposing a DECODER class; both receive numpy batches without copies.
+"""
+
+import ctypes
+import importlib.util
+import pathlib
+from queue import Empty, Full, Queue
+from threading import Thread
+
+import numpy as np
+
+import baseline
+import equalize
+import tracking
+
+# must match ps_annotation in plugins/decoder_plugin.h
+ANNOTATION = np.dtype([('start', '<i8'), ('end', '<i8'), ('value', '<i8'),
+                       ('kind', '<u2'), ('flags', '<u2')], align=True)
+
+STREAMS = {'uint16': 0, 'int16': 1, 'uint32': 2, 'logic': 3, 'annotations': 4}
+SAMPLES = ('uint16', 'int16', 'uint32')
+
+KIND_EDGE, KIND_BYTE, KIND_FRAME, KIND_GLITCH, KIND_MEASUREMENT = range(5)
+KIND_USER = 256
+KINDS = {KIND_EDGE: 'edge', KIND_BYTE: 'byte', KIND_FRAME: 'frame',
+         KIND_GLITCH: 'glitch', KIND_MEASUREMENT: 'measurement'}
+
+FLAG_ERROR, FLAG_START, FLAG_END = 1, 2, 4
+
+
+def annotations(rows=()):
+    """Build an annotation batch from (start, end, value, kind, flags) tuples"""
+    return np.array(list(rows), dtype=ANNOTATION)
+
+
+def parse_options(text):
+    """'key=value;key=value' to a dict of numbers (or strings)"""
+    options = {}
+    for item in filter(None, (t.strip() for t in text.split(';'))):
+        key, _, value = item.partition('=')
+        try:
+            options[key.strip()] = float(value) if '.' in value else int(value, 0)
+        except ValueError:
+            options[key.strip()] = value.strip()
+    return options
+
+
+class Decoder:
+    """Base class for streaming decoders"""
+
+    name = ''
+    input = 'logic'
+    output = 'annotations'
+
+    def feed(self, batch):
+        """Consume one batch, return whatever output is complete"""
+        raise NotImplementedError
+
+    def flush(self):
+        """Return output still pending at the end of the stream"""
+        return annotations()
+
+    def close(self):
+        pass
+
+
+class Slicer(Decoder):
+    """Raw samples to logic levels with a fixed threshold"""
+
+    name = 'slicer'
+    input = 'samples'
+    output = 'logic'
+
+    def __init__(self, threshold=1000):
+        self.threshold = threshold
+
+    def feed(self, batch):
+        return (batch >= self.threshold).view(np.uint8)
+
+    def flush(self):
+        return np.empty(0, np.uint8)
+
+
+class TrackingSlicerDecoder(Decoder):
+    """Raw samples to logic levels with an adaptive threshold, see tracking.TrackingSlicer"""
+
+    name = 'tracker'
+    input = 'samples'
+    output = 'logic'
+
+    def __init__(self, threshold=1000, attack=512, decay=8192, hysteresis=0.1):
+        self.slicer = tracking.TrackingSlicer(threshold, attack, decay, hysteresis)
+
+    def feed(self, batch):
+        return self.slicer.feed(batch)
+
+    def flush(self):
+        return self.slicer.flush()
+
+
+class BaselineDecoder(Decoder):
+    """Raw samples to baseline-restored samples, see baseline.Restorer"""
+
+    name = 'baseline'
+    input = 'samples'
+    output = 'samples'
+
+    def __init__(self, window=4001, level=0):
+        self.restorer = baseline.Restorer(window, level)
+
+    def feed(self, batch):
+        return self.restorer.feed(batch)
+
+    def flush(self):
+        return self.restorer.flush()
+
+
+class EqualizerDecoder(Decoder):
+    """Raw samples to CTLE/FFE/DFE equalized samples, see equalize.Equalizer
+
+    Taps adapt on the first batch; zero and pole (Hz, with rate) enable the CTLE.
+    """
+
+    name = 'equalizer'
+    input = 'samples'
+    output = 'samples'
+
+    def __init__(self, bit=16, threshold=1000, rate=1.0, zero=0, pole=0, ffe=7, dfe=2):
+        self.eq = equalize.Equalizer(bit, threshold, rate, zero, pole, ffe, dfe)
+
+    def feed(self, batch):
+        return self.eq.feed(batch)
+
+    def flush(self):
+        return self.eq.flush()
+
+
+class EdgeDecoder(Decoder):
+    """Logic levels to edge annotations (value is the new level)"""
+
+    name = 'edges'
+
+    def __init__(self):
+        self.offset = 0
+        self.level = None
+
+    def feed(self, batch):
+        if self.level is None and len(batch):
+            self.level = batch[0]
+        prev = np.empty_like(batch)
+        prev[:1] = self.level
+        prev[1:] = batch[:-1]
+        idx = np.flatnonzero(batch != prev)
+        out = np.zeros(len(idx), ANNOTATION)
+        out['start'] = out['end'] = idx + self.offset
+        out['value'] = batch[idx]
+        out['kind'] = KIND_EDGE
+        self.offset += len(batch)
+        if len(batch):
+            self.level = batch[-1]
+        return out
+
+
+class UartDecoder(Decoder):
+    """Logic levels to UART bytes (8N1, LSB first, idle high)"""
+
+    name = 'uart'
+
+    def __init__(self, bit=16, bits=8):
+        self.bit = float(bit)
+        self.bits = int(bits)
+        self.offset = 0
+        self.tail = np.ones(1, np.uint8)
+        self.taps = np.round((np.arange(self.bits) + 1.5) * self.bit).astype(np.int64)
+        self.stop = int(round((self.bits + 1.5) * self.bit))
+        self.weights = 1 << np.arange(self.bits)
+
+    def feed(self, batch):
+        buf = np.concatenate((self.tail, batch))
+        base = self.offset - len(self.tail)
+        self.offset += len(batch)
+        falling = np.flatnonzero((buf[1:] == 0) & (buf[:-1] == 1)) + 1
+        half = int(round(0.5 * self.bit))
+        frame = int(round((self.bits + 2) * self.bit))
+        rows = []
+        pos = 0
+        keep = max(len(buf) - 1, 0)
+        for i in falling:
+            if i < pos:
+                continue
+            if i + self.stop >= len(buf):
+                keep = i - 1
+                break
+            value = int(buf[i + self.taps] @ self.weights)
+            bad = buf[i + half] != 0 or buf[i + self.stop] != 1
+            rows.append((base + i, base + i + frame - 1, value, KIND_BYTE, FLAG_ERROR if bad else 0))
+            pos = i + self.stop
+        else:
+            keep = max(keep, pos)
+        self.tail = buf[keep:].copy()
+        return annotations(rows)
+
+
+BUILTIN = {d.name: d for d in (BaselineDecoder, EqualizerDecoder, Slicer, TrackingSlicerDecoder, EdgeDecoder, UartDecoder)}
+
+
+class _PsDecoder(ctypes.Structure):
+    _fields_ = [
+        ('abi_version', ctypes.c_uint32),
+        ('name', ctypes.c_char_p),
+        ('input', ctypes.c_uint32),
+        ('output', ctypes.c_uint32),
+        ('create', ctypes.CFUNCTYPE(ctypes.c_void_p, ctypes.c_char_p)),
+        ('destroy', ctypes.CFUNCTYPE(None, ctypes.c_void_p)),
+        ('decode', ctypes.CFUNCTYPE(ctypes.c_int64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int64,
+                                    ctypes.c_void_p, ctypes.c_int64)),
+    ]
+
+
+ABI_VERSION = 1
+
+
+class SharedObjectDecoder(Decoder):
+    """Decoder backed by a shared object implementing the C plugin ABI"""
+
+    def __init__(self, table, options=''):
+        self.table = table
+        self.name = table.name.decode()
+        self.input = {v: k for k, v in STREAMS.items()}[table.input]
+        self.state = table.create(options.encode())
+        if not self.state:
+            raise RuntimeError("plugin %s failed to initialize" % self.name)
+
+    def _call(self, batch, n):
+        cap = max(n, 4096)
+        parts = []
+        while True:
+            out = np.empty(cap, ANNOTATION)
+            got = self.table.decode(self.state, batch.ctypes.data if n else None, n, out.ctypes.data, cap)
+            if got < 0:
+                raise RuntimeError("plugin %s failed to decode" % self.name)
+            parts.append(out[:got])
+            if got < cap:
+                break
+            batch, n = batch[:0], 0
+        return np.concatenate(parts)
+
+    def feed(self, batch):
+        dtype = ANNOTATION if self.input == 'annotations' else np.dtype(
+            np.uint8 if self.input == 'logic' else self.input)
+        # zero-copy when the batch already has the plugin's layout
+        batch = np.ascontiguousarray(batch, dtype=dtype)
+        return self._call(batch, len(batch))
+
+    def flush(self):
+        return self._call(np.empty(0, ANNOTATION), 0)
+
+    def close(self):
+        if self.state:
+            self.table.destroy(self.state)
+            self.state = None
+
+
+def load_plugin(path):
+    """Load one plugin file, return (name, factory taking an options string)"""
+    path = pathlib.Path(path)
+    if path.suffix == '.py':
+        spec = importlib.util.spec_from_file_location(path.stem, path)
+        module = importlib.util.module_from_spec(spec)
+        spec.loader.exec_module(module)
+        cls = module.DECODER
+        return cls.name, lambda options='': cls(**parse_options(options))
+    lib = ctypes.CDLL(str(path.absolute()))
+    entry = lib.ps_decoder_entry
+    entry.restype = ctypes.POINTER(_PsDecoder)
+    table = entry().contents
+    if table.abi_version != ABI_VERSION:
+        raise RuntimeError("%s: plugin ABI %d, expected %d" % (path, table.abi_version, ABI_VERSION))
+    table._lib = lib  # keep the library loaded
+    return table.name.decode(), lambda options='': SharedObjectDecoder(table, options)
+
+
+def load_plugins(directory):
+    """Registry of built-in decoders plus every plugin found in directory"""
+    registry = {name: (lambda cls: lambda options='': cls(**parse_options(options)))(cls)
+                for name, cls in BUILTIN.items()}
+    directory = pathlib.Path(directory)
+    if directory.is_dir():
+        for path in sorted(directory.iterdir()):
+            if path.suffix in ('.so', '.dll', '.dylib', '.py'):
+                name, factory = load_plugin(path)
+                registry[name] = factory
+    return registry
+
+
+class Stack:
+    """Decoders chained so each consumes the output of the previous one"""
+
+    def __init__(self, decoders):
+        self.decoders = list(decoders)
+        for a, b in zip(self.decoders, self.decoders[1:]):
+            if b.input != a.output and not (b.input in SAMPLES + ('samples',) and a.output in SAMPLES):
+                raise ValueError("%s outputs %s, %s expects %s" % (a.name, a.output, b.name, b.input))
+
+    def feed(self, batch):
+        for d in self.decoders:
+            batch = d.feed(batch)
+        return batch
+
+    def flush(self):
+        out = None
+        for d in self.decoders:
+            # the upstream tail goes in before this decoder flushes what it holds
+            out = d.flush() if out is None or not len(out) else np.concatenate((d.feed(out), d.flush()))
+        return out
+
+    def close(self):
+        for d in self.decoders:
+            d.close()
+
+
+def build(spec, registry):
+    """Stack from a spec such as 'slicer:threshold=1000 | uart:bit=16 | framing'"""
+    decoders = []
+    for part in filter(None, (p.strip() for p in spec.split('|'))):
+        name, _, options = part.partition(':')
+        if name.strip() not in registry:
+            raise ValueError("unknown decoder %r" % name.strip())
+        decoders.append(registry[name.strip()](options.replace(',', ';')))
+    return Stack(decoders)
+
+
+def set_options(spec, name, **options):
+    """spec with options set on each stage called name, the rest kept as written"""
+    parts = []
+    for part in filter(None, (p.strip() for p in spec.split('|'))):
+        stage, colon, text = part.partition(':')
+        if stage.strip() == name:
+            items = [t.strip() for t in text.replace(',', ';').split(';') if t.strip()]
+            keys = [t.partition('=')[0].strip() for t in items]
+            items = ['%s=%s' % (k, options[k]) if k in options else t for k, t in zip(keys, items)]
+            items += ['%s=%s' % kv for kv in options.items() if kv[0] not in keys]
+            part = '%s:%s' % (stage.strip(), ';'.join(items))
+        parts.append(part)
+    return ' | '.join(parts)
+
+
+class Pipeline:
+    """Runs a stack on its own thread; bounded queues give backpressure
+
+    A failing stack or a consumer that stops reading (cancel) stops the
+    stream, so neither the producer nor the worker is left blocked on a
+    full queue holding the capture.
+    """
+
+    POLL = 0.1
+
+    def __init__(self, stack, depth=8):
+        self.stack = stack
+        self.inbox = Queue(maxsize=depth)
+        self.outbox = Queue(maxsize=depth)
+        self.stopped = False  # set on error or cancel; the producer stops feeding
+        self.cancelled = False  # the consumer has gone; nothing more is delivered
+        self.thread = Thread(target=self._run, daemon=True)
+        self.thread.start()
+
+    def _put(self, queue, item, stop):
+        while not stop():
+            try:
+                queue.put(item, timeout=self.POLL)
+                return True
+            except Full:
+                pass
+        return False
+
+    def _emit(self, item):
+        return self._put(self.outbox, item, lambda: self.cancelled)
+
+    def _next(self):
+        while not self.stopped:
+            try:
+                return self.inbox.get(timeout=self.POLL)
+            except Empty:
+                pass
+        return None
+
+    def _run(self):
+        try:
+            while True:
+                batch = self._next()
+                if batch is None:
+                    break
+                out = self.stack.feed(batch)
+                if len(out):
+                    self._emit(out)
+            if not self.stopped:
+                out = self.stack.flush()
+                if len(out):
+                    self._emit(out)
+        except Exception as e:
+            self.stopped = True
+            self._emit(e)
+        finally:
+            self._emit(None)
+
+    def put(self, batch):
+        """Queue one batch; False once the stream has stopped"""
+        return self._put(self.inbox, batch, lambda: self.stopped)
+
+    def close(self):
+        self._put(self.inbox, None, lambda: self.stopped)
+
+    def cancel(self):
+        """Stop the stream from the consumer side"""
+        self.stopped = self.cancelled = True
+
+    def results(self):
+        """Yield output batches until the stream ends"""
+        while True:
+            out = self.outbox.get()
+            if out is None:
+                break
+            if isinstance(out, Exception):
+                raise out
+            yield out
+
+
+def decode(samples, stack, batch=1 << 20, sink=None):
+    """Run stack over a whole sample buffer, return all output annotations
+
+    sink, if given, is called with every output batch as it is produced.
+    """
+    pipe = Pipeline(stack)
+
+    def producer():
+        for s in range(0, len(samples), batch):
+            if not pipe.put(samples[s:s + batch]):
+                return
+        pipe.close()
+
+    Thread(target=producer, daemon=True).start()
+    parts = []
+    try:
+        for out in pipe.results():
+            parts.append(out)
+            if sink is not None:
+                sink(out)
+    finally:
+        pipe.cancel()  # no-op once the stream has ended
+    return np.concatenate(parts) if parts else annotations()
@@ -0,0 +1,88 @@
+# -*- coding: utf-8 -*-
+"""
+Inter-channel delay and skew.
+
+The cross-correlation is the inverse FFT of the Welch-averaged cross
+spectrum, so a whole capture is handled in parallel segments, and the peak
+is refined to a fraction of a sample with a parabola through its
+neighbours. Sliding windows give delay drift over time. FractionalDelay
+deskews a channel with a windowed-sinc FIR, evaluated only over the range
+being drawn.
+"""
+
+import numpy as np
+
+import transfer
+from workers import map_chunks
+
+
+def peak(r, lags):
+    """Sub-sample lag and height of the largest value of r"""
+    i = int(np.argmax(r))
+    if 0 < i < len(r) - 1:
+        a, b, c = r[i - 1], r[i], r[i + 1]
+        den = a - 2 * b + c
+        frac = 0.5 * (a - c) / den if den else 0.0
+        return lags[i] + frac, b - 0.25 * (a - c) * frac
+    return float(lags[i]), r[i]
+
+
+def correlate(x, y, nperseg=1 << 16):
+    """(delay of y behind x in samples, correlation coefficient) over all of x, y"""
+    nperseg = min(nperseg, min(len(x), len(y)))
+    f, sxx, syy, sxy = transfer.welch(x, y, nperseg)
+    r = np.fft.irfft(sxy, nperseg)
+    norm = np.sqrt(np.sum(sxx) * np.sum(syy)) / nperseg * 2
+    lags = np.fft.fftfreq(nperseg, 1 / nperseg)
+    order = np.argsort(lags)
+    lag, height = peak(r[order], lags[order])
+    return lag, height / norm if norm else 0.0
+
+
+def _window_delay(x, y, max_lag):
+    x = x - x.mean()
+    y = y - y.mean()
+    n = 1 << int(np.ceil(np.log2(len(x) + max_lag + 1)))
+    r = np.fft.irfft(np.conj(np.fft.rfft(x, n)) * np.fft.rfft(y, n), n)
+    r = np.concatenate((r[-max_lag:], r[:max_lag + 1]))
+    norm = np.sqrt((x @ x) * (y @ y))
+    lag, height = peak(r, np.arange(-max_lag, max_lag + 1))
+    return lag, height / norm if norm else 0.0
+
+
+def drift(x, y, window=1 << 16, step=None, max_lag=1024):
+    """(window centres, delays, coefficients) over sliding windows"""
+    n = min(len(x), len(y))
+    step = step or window
+    starts = np.arange(0, max(n - window, 0) + 1, step)
+
+    def work(s, e):
+        return [_window_delay(np.asarray(x[a:a + window], np.float64),
+                              np.asarray(y[a:a + window], np.float64), max_lag) for a in starts[s:e]]
+
+    out = [d for part in map_chunks(work, len(starts), 8) for d in part]
+    delays = np.array([d for d, _ in out])
+    coeffs = np.array([c for _, c in out])
+    return starts + window / 2, delays, coeffs
+
+
+class FractionalDelay:
+    """Delays a channel by a (possibly fractional) number of samples, lazily"""
+
+    def __init__(self, delay, taps=32):
+        self.shift = int(np.floor(delay))
+        frac = delay - self.shift
+        k = np.arange(taps) - taps // 2 + 1
+        self.half = taps // 2
+        self.taps = np.sinc(k - frac) * np.blackman(taps)
+        self.taps /= self.taps.sum()
+
+    def render(self, y, start, stop):
+        """Samples start..stop of y delayed, touching only the input they need"""
+        lo = start - self.shift - self.half
+        hi = stop - self.shift + self.half - 1
+        src = np.zeros(hi - lo, np.float64)
+        a, b = max(lo, 0), min(hi, len(y))
+        if b > a:
+            src[a - lo:b - lo] = y[a:b]
+        return np.convolve(src, self.taps, 'valid')[:stop - start]
@@ -0,0 +1,252 @@
+# -*- coding: utf-8 -*-
+"""
+Receiver equalizer emulation: CTLE, FFE and DFE ahead of the slicer.
+
+Samples are first normalised so the two levels sit near -1 and +1 around the
+slicer threshold. The CTLE is an analog one-zero, two-pole peaking filter
+mapped to a digital biquad (bilinear, prewarped) and applied as its
+truncated impulse response with FFT convolution. The FFE has T-spaced taps
+and the DFE feeds back sliced decisions; both are trained on the first part
+of the capture with block LMS, each update one matrix product. DFE decisions
+are found by fixed-point iteration over whole blocks, which only needs a
+sequential pass where an error would otherwise propagate. The equalized
+waveform is returned at the full sample rate, so the eye and the slicer see
+what an equalizing receiver would.
+"""
+
+import numpy as np
+
+import eye
+
+
+def ctle_taps(rate, zero, pole, pole2=None, tol=1e-10):
+    """Impulse response of (1 + s/wz) / ((1 + s/wp)(1 + s/wp2)), unity DC gain"""
+    pole2 = pole2 or rate / 4
+    k = 2 * rate
+
+    def factor(f):
+        # 1 + s / w with s = k (1 - z^-1) / (1 + z^-1), times (1 + z^-1)
+        c = k / (2 * rate * np.tan(np.pi * f / rate))
+        return np.array([1 + c, 1 - c])
+
+    b = np.convolve(factor(zero), [1.0, 1.0])
+    a = np.convolve(factor(pole), factor(pole2))
+    n = 1 << 16
+    h = np.fft.irfft(np.fft.rfft(b, n) / np.fft.rfft(a, n), n)
+    energy = np.cumsum(h ** 2)
+    return h[:int(np.searchsorted(energy, energy[-1] * (1 - tol))) + 1]
+
+
+def convolve(x, h):
+    """'valid' part of x * h by FFT"""
+    n = len(x) + len(h) - 1
+    nfft = 1 << int(np.ceil(np.log2(max(n, 1))))
+    y = np.fft.irfft(np.fft.rfft(x, nfft) * np.fft.rfft(h, nfft), nfft)
+    return y[len(h) - 1:len(x)]
+
+
+def dfe_decide(z, b, prev):
+    """Decisions d_k = sign(z_k - sum_i b_i d_(k-1-i)) following decisions prev"""
+    d = np.where(z >= 0, 1.0, -1.0)
+    n = len(b)
+    if not n or not len(z):
+        return d
+    for _ in range(16):
+        full = np.concatenate((prev, d))
+        fb = sum(b[i] * full[n - 1 - i:n - 1 - i + len(z)] for i in range(n))
+        new = np.where(z - fb >= 0, 1.0, -1.0)
+        changed = np.flatnonzero(new != d)
+        d = new
+        if not len(changed):
+            return d
+    # everything before the first change is settled; finish sequentially
+    full = np.concatenate((prev, d))
+    for k in range(changed[0], len(z)):
+        full[n + k] = 1.0 if z[k] - b @ full[n + k - 1::-1][:n] >= 0 else -1.0
+    return full[n:]
+
+
+def feedback(b, dec):
+    """sum_i b_i d_(k-1-i) for every k, dec holding len(b) earlier decisions first"""
+    n = len(b)
+    m = len(dec) - n
+    return sum(b[i] * dec[n - 1 - i:n - 1 - i + m] for i in range(n)) if n else np.zeros(m)
+
+
+class Equalizer:
+    """CTLE + FFE + DFE on a sample stream; fit once, then feed blocks"""
+
+    def __init__(self, sps, threshold=1000, rate=1.0, zero=0.0, pole=0.0,
+                 ffe=7, dfe=2, mu=0.1, train=20000):
+        self.sps = float(sps)
+        self.threshold = threshold
+        self.rate = rate
+        self.h = ctle_taps(rate, zero, pole) if zero and pole else np.ones(1)
+        self.main = ffe // 2
+        self.w = np.zeros(max(ffe, 1))
+        self.w[self.main] = 1.0
+        self.b = np.zeros(dfe)
+        self.mu = mu
+        self.train = train
+        self.scale = None
+
+    def normalise(self, x):
+        return (np.asarray(x, np.float64) - self.threshold) / self.scale
+
+    def fit(self, x):
+        """Levels, CTLE sampling phase and adapted FFE/DFE taps from x"""
+        x = np.asarray(x, np.float64)
+        self.scale = float(np.mean(np.abs(x - self.threshold))) or 1.0
+        self.raw_phase = eye.best_phase(x, self.sps, self.threshold)
+        xn = self.normalise(x)
+        xc = convolve(np.concatenate((np.full(len(self.h) - 1, xn[0]), xn)), self.h)
+        self.phase = eye.best_phase(xc, self.sps, 0.0)
+        u = eye.sample(xc, eye.symbol_times(self.sps, self.phase, 0, len(xc))[1])[:self.train]
+        n, m = len(self.w), len(self.b)
+        if len(u) > n:
+            # row r holds u_(k + main - j) for tap j, k = r + n - 1 - main
+            U = np.lib.stride_tricks.sliding_window_view(u, n)[:, ::-1]
+            for epoch in range(4):
+                prev = np.ones(m)
+                for r in range(0, len(U), 32):
+                    Ub = U[r:r + 32]
+                    z = Ub @ self.w
+                    d = dfe_decide(z, self.b, prev)
+                    full = np.concatenate((prev, d))
+                    D = np.stack([full[m - 1 - i:m - 1 - i + len(d)] for i in range(m)], axis=1) \
+                        if m else np.zeros((len(d), 0))
+                    e = d - (z - D @ self.b)
+                    self.w += self.mu * Ub.T @ e / len(e)
+                    self.b -= self.mu * D.T @ e / len(e)
+                    prev = full[len(full) - m:]
+        self.reset()
+        return self
+
+    def reset(self):
+        """Start a new stream at absolute sample 0"""
+        self.tail = None
+        self.xc = np.empty(0)
+        self.xc_start = 0
+        self.yf = np.empty(0)
+        self.yf_start = 0
+        self.k = 0  # next symbol to decide
+        self.dec = np.zeros(len(self.b))  # decisions before symbol dec_start
+        self.dec_start = 0
+        self.out_pos = 0
+        self.count = 0
+
+    def feed(self, batch):
+        """Equalized samples (original units, float32) for as much as is decided"""
+        if not len(batch):
+            return np.empty(0, np.float32)
+        if self.scale is None:
+            self.fit(batch)
+        xn = self.normalise(batch)
+        self.count += len(xn)
+        self.last = batch[-1]
+        if self.tail is None:
+            self.tail = np.full(len(self.h) - 1, xn[0])
+        seg = np.concatenate((self.tail, xn))
+        self.tail = seg[len(seg) - len(self.h) + 1:]
+        self.xc = np.concatenate((self.xc, convolve(seg, self.h)))
+        xc_end = self.xc_start + len(self.xc)
+
+        # FFE at full rate, once its latest tap has arrived
+        n, main = len(self.w), self.main
+        last = int(np.floor(xc_end - 1 - main * self.sps))
+        t = np.arange(self.yf_start + len(self.yf), last + 1)
+        y = sum(self.w[j] * eye.sample(self.xc, t + (main - j) * self.sps, self.xc_start) for j in range(n))
+        self.yf = np.concatenate((self.yf, y))
+        yf_end = self.yf_start + len(self.yf)
+
+        # symbol decisions through the DFE
+        k = np.arange(self.k, int(np.floor((yf_end - 1 - self.phase) / self.sps)) + 1)
+        times = self.phase + k * self.sps
+        if len(k):
+            z = eye.sample(self.yf, times, self.yf_start)
+            m = len(self.b)
+            prev = self.dec[len(self.dec) - m:] if m else np.empty(0)
+            self.dec = np.concatenate((self.dec, dfe_decide(z, self.b, prev)))
+            self.k = int(k[-1]) + 1
+
+        # full-rate output where the feedback is known: symbol k(t) <= self.k
+        stop = min(yf_end, int(np.ceil(self.phase + (self.k + 0.5) * self.sps)))
+        t = np.arange(self.out_pos, stop)
+        kt = np.floor((t - self.phase) / self.sps + 0.5).astype(np.int64)
+        fb = feedback(self.b, np.append(self.dec, 0.0))
+        # fb[i] is the feedback for symbol dec_start + i; before symbol 0 there is none
+        idx = np.clip(kt - self.dec_start, 0, len(fb) - 1) if len(fb) else None
+        out = self.yf[t - self.yf_start]
+        if idx is not None:
+            out = out - np.where(kt >= 0, fb[idx], 0.0)
+        self.out_pos = stop
+
+        # keep only the history still needed
+        keep = int(np.floor(self.out_pos - (n - 1 - main) * self.sps)) - 2
+        drop = max(0, min(keep - self.xc_start, len(self.xc)))
+        self.xc, self.xc_start = self.xc[drop:], self.xc_start + drop
+        drop = max(0, min(self.out_pos - 2 - int(self.sps) - self.yf_start, len(self.yf)))
+        self.yf, self.yf_start = self.yf[drop:], self.yf_start + drop
+        first = max(int(np.floor((self.out_pos - self.phase) / self.sps + 0.5)) - 1, self.dec_start)
+        drop = min(first - self.dec_start, len(self.dec) - len(self.b))
+        if drop > 0:
+            self.dec, self.dec_start = self.dec[drop:], self.dec_start + drop
+        return (out * self.scale + self.threshold).astype(np.float32)
+
+    def flush(self):
+        """The samples still held back, the input's last value carried forward"""
+        if self.tail is None:
+            return np.empty(0, np.float32)
+        pending = self.count - self.out_pos
+        pad = int((len(self.h) + (self.main + 2) * self.sps)) + 2
+        out = self.feed(np.full(pad, self.last, np.float64))
+        return out[:pending]
+
+
+def equalize(x, eq, block=1 << 20):
+    """Equalized copy of a whole capture, fitting eq on its start if needed"""
+    if eq.scale is None:
+        eq.fit(x[:int(eq.train * eq.sps)])
+    eq.reset()
+    parts = [eq.feed(x[s:s + block]) for s in range(0, len(x), block)]
+    parts.append(eq.flush())
+    return np.concatenate(parts)
+
+
+def compare(x, eq, bins=(128, 128), block=1 << 20):
+    """Eyes and Q/BER before and after equalization, from one pass over x
+
+    Returns {'raw': ..., 'equalized': ...}, each with the Eye, Q factor,
+    estimated BER and the eye opening at the symbol centres.
+    """
+    if eq.scale is None:
+        eq.fit(x[:int(eq.train * eq.sps)])
+    eq.reset()
+    first = np.asarray(x[:block], np.float64)
+    lo, hi = np.percentile(first, (0.1, 99.9))
+    yrange = (lo - 0.25 * (hi - lo), hi + 0.25 * (hi - lo))
+    eyes = {'raw': eye.Eye(eq.sps, eq.raw_phase, yrange, bins),
+            'equalized': eye.Eye(eq.sps, eq.phase, yrange, bins)}
+    values = {'raw': [], 'equalized': []}
+    pos = 0
+
+    def collect(name, data, start, phase):
+        eyes[name].add(data, start)
+        values[name].append(eye.sample(data, eye.symbol_times(eq.sps, phase, start, start + len(data))[1], start))
+
+    for s in range(0, len(x), block):
+        raw = np.asarray(x[s:s + block], np.float64)
+        collect('raw', raw, s, eq.raw_phase)
+        out = eq.feed(raw)
+        collect('equalized', out, pos, eq.phase)
+        pos += len(out)
+    out = eq.flush()
+    collect('equalized', out, pos, eq.phase)
+    result = {}
+    for name in eyes:
+        v = np.concatenate(values[name])
+        q, ber = eye.q_factor(v, eq.threshold)
+        high, low = v[v >= eq.threshold], v[v < eq.threshold]
+        opening = float(np.percentile(high, 0.1) - np.percentile(low, 99.9)) if len(high) and len(low) else 0.0
+        result[name] = {'eye': eyes[name], 'q': q, 'ber': ber, 'opening': opening}
+    return result
@@ -0,0 +1,220 @@
+# -*- coding: utf-8 -*-
+"""
+Columnar in-memory store for decoded events (bytes, frames, glitches,
+measurements).
+
+Columns are plain numpy arrays: time, duration, type, value, flags. Type
+names are dictionary encoded into small integer codes. Rows are kept sorted
+by time, so a time window is two binary searches and every other filter is
+one vectorized mask over that window.
+
+    python events.py capture.txt --stack "slicer | uart:bit=16 | framing" \\
+        --type frame --errors --rate 1e6 --per 1
+"""
+
+import argparse
+import csv
+import sys
+
+import numpy as np
+
+import capture
+import decoders
+
+COLUMNS = ('time', 'duration', 'type', 'value', 'flags')
+DTYPES = {'time': np.int64, 'duration': np.int64, 'type': np.uint16,
+          'value': np.int64, 'flags': np.uint16}
+
+
+class EventStore:
+    """Append-only columnar event table with a sorted time index"""
+
+    def __init__(self):
+        self.types = []
+        self.codes = {}
+        self.columns = {c: np.empty(0, DTYPES[c]) for c in COLUMNS}
+        self.pending = []
+
+    def __len__(self):
+        self._consolidate()
+        return len(self.columns['time'])
+
+    def code(self, name):
+        """Dictionary code of a type name, added on first use"""
+        if name not in self.codes:
+            self.codes[name] = len(self.types)
+            self.types.append(name)
+        return self.codes[name]
+
+    def append(self, time, duration, kind, value, flags=0):
+        """Append a batch of events; kind is a type name or an array of codes"""
+        n = len(time)
+        if isinstance(kind, str):
+            kind = np.full(n, self.code(kind), np.uint16)
+        cols = {'time': time, 'duration': duration, 'type': kind, 'value': value, 'flags': flags}
+        self.pending.append({c: np.broadcast_to(np.asarray(v, DTYPES[c]), n) for c, v in cols.items()})
+
+    def add_annotations(self, batch, names=decoders.KINDS):
+        """Append a decoder annotation batch, mapping kinds to type names"""
+        if not len(batch):
+            return
+        lut = np.array([self.code(names.get(k, 'kind%d' % k)) for k in range(int(batch['kind'].max()) + 1)],
+                       np.uint16)
+        self.append(batch['start'], batch['end'] - batch['start'] + 1, lut[batch['kind']],
+                    batch['value'], batch['flags'])
+
+    @classmethod
+    def from_annotations(cls, batch):
+        store = cls()
+        store.add_annotations(batch)
+        return store
+
+    def _consolidate(self):
+        # appends are batched; merge and re-sort only when someone reads
+        if not self.pending:
+            return
+        cols = {c: np.concatenate([self.columns[c]] + [p[c] for p in self.pending]) for c in COLUMNS}
+        self.pending = []
+        time = cols['time']
+        if len(time) > 1 and np.any(time[1:] < time[:-1]):
+            order = np.argsort(time, kind='stable')
+            cols = {c: v[order] for c, v in cols.items()}
+        self.columns = cols
+
+    def query(self, t0=None, t1=None):
+        """Start a query over the time window [t0, t1)"""
+        self._consolidate()
+        time = self.columns['time']
+        lo = 0 if t0 is None else int(np.searchsorted(time, t0, 'left'))
+        hi = len(time) if t1 is None else int(np.searchsorted(time, t1, 'left'))
+        return Query(self, lo, max(lo, hi))
+
+
+class Query:
+    """Vectorized filter and aggregate over a time slice of the store"""
+
+    def __init__(self, store, lo, hi, mask=None):
+        self.store = store
+        self.lo = lo
+        self.hi = hi
+        self.mask = mask
+
+    def column(self, name):
+        v = self.store.columns[name][self.lo:self.hi]
+        return v if self.mask is None else v[self.mask]
+
+    def where(self, mask):
+        mask = np.asarray(mask, bool)
+        return Query(self.store, self.lo, self.hi, mask if self.mask is None else self.mask & mask)
+
+    def _col(self, name):
+        return self.store.columns[name][self.lo:self.hi]
+
+    def type(self, *names):
+        """Keep events of the given type names"""
+        codes = [self.store.codes[n] for n in names if n in self.store.codes]
+        return self.where(np.isin(self._col('type'), codes))
+
+    def flags(self, all=0, none=0):
+        """Keep events with every bit of all set and no bit of none set"""
+        f = self._col('flags')
+        return self.where(((f & all) == all) & ((f & none) == 0))
+
+    def errors(self):
+        return self.flags(all=decoders.FLAG_ERROR)
+
+    def value(self, lo=None, hi=None):
+        """Keep events with lo <= value < hi"""
+        v = self._col('value')
+        mask = np.ones(len(v), bool)
+        if lo is not None:
+            mask &= v >= lo
+        if hi is not None:
+            mask &= v < hi
+        return self.where(mask)
+
+    def count(self):
+        return self.hi - self.lo if self.mask is None else int(np.count_nonzero(self.mask))
+
+    def count_per(self, width, t0=None):
+        """Histogram of event times in bins of width samples: (bin starts, counts)"""
+        time = self.column('time')
+        if not len(time):
+            return np.empty(0, np.int64), np.empty(0, np.int64)
+        t0 = time[0] if t0 is None else t0
+        bins = ((time - t0) // width).astype(np.int64)
+        counts = np.bincount(bins)
+        return t0 + width * np.arange(len(counts)), counts
+
+    def stats(self, name='value'):
+        """min, max, mean and sum of a column over the selection"""
+        v = self.column(name)
+        if not len(v):
+            return {'count': 0}
+        return {'count': len(v), 'min': v.min(), 'max': v.max(), 'mean': float(v.mean()), 'sum': v.sum()}
+
+    def rows(self, limit=None):
+        """Selected rows as a structured array (type as codes, see type_names)"""
+        index = np.arange(self.lo, self.hi) if self.mask is None else self.lo + np.flatnonzero(self.mask)
+        if limit is not None:
+            index = index[:limit]
+        out = np.empty(len(index), [(c, DTYPES[c]) for c in COLUMNS])
+        for c in COLUMNS:
+            out[c] = self.store.columns[c][index]
+        return out
+
+    def type_names(self, codes):
+        """Decode type codes back to names"""
+        return np.asarray(self.store.types, object)[codes] if len(codes) else np.empty(0, object)
+
+    def to_csv(self, path_or_file):
+        """Export the selection, one row per event"""
+        rows = self.rows()
+        names = self.type_names(rows['type'])
+        own = isinstance(path_or_file, str)
+        f = open(path_or_file, 'w', newline='') if own else path_or_file
+        try:
+            w = csv.writer(f)
+            w.writerow(COLUMNS)
+            for r, name in zip(rows, names):
+                w.writerow((r['time'], r['duration'], name, r['value'], r['flags']))
+        finally:
+            if own:
+                f.close()
+
+
+def main(argv=None):
+    p = argparse.ArgumentParser(description="Decode a capture and query its events")
+    p.add_argument('path')
+    p.add_argument('--dtype', default='uint16', choices=capture.DTYPES, help="of text captures; others carry their own")
+    p.add_argument('--stack', default='slicer:threshold=1000 | uart:bit=16')
+    p.add_argument('--plugins', default='plugins')
+    p.add_argument('--t0', type=int)
+    p.add_argument('--t1', type=int)
+    p.add_argument('--type', nargs='*', default=[])
+    p.add_argument('--errors', action='store_true', help="only events flagged as errors")
+    p.add_argument('--rate', type=float, default=1.0, help="sample rate, for --per")
+    p.add_argument('--per', type=float, help="print counts per this many seconds")
+    p.add_argument('--csv', help="export the selection to this file ('-' for stdout)")
+    args = p.parse_args(argv)
+
+    stack = decoders.build(args.stack, decoders.load_plugins(args.plugins))
+    try:
+        store = EventStore.from_annotations(decoders.decode(capture.load(args.path, args.dtype), stack))
+    finally:
+        stack.close()
+    q = store.query(args.t0, args.t1)
+    if args.type:
+        q = q.type(*args.type)
+    if args.errors:
+        q = q.errors()
+    print("%d events" % q.count(), file=sys.stderr)
+    if args.per:
+        for start, n in zip(*q.count_per(max(1, int(args.per * args.rate)))):
+            print("%.6f\t%d" % (start / args.rate, n))
+    if args.csv:
+        q.to_csv(sys.stdout if args.csv == '-' else args.csv)
+
+
+if __name__ == '__main__':
+    main()
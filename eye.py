@@ -0,0 +1,101 @@
+# -*- coding: utf-8 -*-
+"""
+Eye diagrams by folding a waveform on the bit period.
+
+Every sample lands in a 2-D histogram of (time within a window of ui unit
+intervals, level). Histograms simply add, so a capture is folded in parallel
+chunks, a stream is folded block by block, and measurements made later work
+from the histogram alone. Symbol centres (phase + k * sps) fold to 0.5,
+1.5, ... UI.
+"""
+
+import math
+
+import numpy as np
+
+from workers import map_chunks
+
+
+class Eye:
+    """Folded (time, level) histogram; hist[i, j] counts time bin i, level bin j
+
+    With a threshold, every sample is also labelled with the bit decided at
+    its own symbol centre, and ones[i, j] counts those labelled 1, so that
+    error rates can be read off the histogram later (see bathtub).
+    """
+
+    def __init__(self, sps, phase=0.0, yrange=(0.0, 4096.0), bins=(128, 128), ui=2, threshold=None):
+        self.sps = float(sps)
+        self.phase = float(phase)
+        self.ui = ui
+        self.bins = bins
+        self.lo, self.hi = map(float, yrange)
+        self.threshold = threshold
+        self.hist = np.zeros(bins, np.int64)
+        self.ones = np.zeros(bins, np.int64) if threshold is not None else None
+        self.times = np.linspace(0, ui, bins[0] + 1)
+        self.levels = np.linspace(self.lo, self.hi, bins[1] + 1)
+
+    def add(self, x, start=0):
+        """Fold samples x, the first of which is absolute sample start"""
+        bt, by = self.bins
+        labelled = self.threshold is not None
+
+        def work(s, e):
+            t = np.arange(start + s, start + e)
+            ui = (t - self.phase) / self.sps + 0.5
+            y = np.asarray(x[s:e], np.float64)
+            keep = np.ones(len(y), bool)
+            if labelled:
+                # a sample whose symbol centre is outside x cannot be labelled
+                centre = self.phase + np.floor(ui) * self.sps
+                keep = (centre >= start) & (centre <= start + len(x) - 1)
+                c = np.clip(centre - start, 0, len(x) - 1)
+                i = c.astype(np.int64)
+                j = np.minimum(i + 1, len(x) - 1)
+                v = np.asarray(x[i], np.float64) * (1 - (c - i)) + np.asarray(x[j], np.float64) * (c - i)
+                bit = v >= self.threshold
+            ti = np.minimum(((ui % self.ui) * (bt / self.ui)).astype(np.int64), bt - 1)
+            yi = np.floor((y - self.lo) * (by / (self.hi - self.lo)))
+            keep &= (yi >= 0) & (yi < by)
+            cell = ti[keep] * by + yi[keep].astype(np.int64)
+            counts = np.bincount(cell, minlength=bt * by)
+            ones = np.bincount(cell[bit[keep]], minlength=bt * by) if labelled else None
+            return counts, ones
+
+        if len(x):
+            parts = map_chunks(work, len(x))
+            self.hist += np.sum([c for c, _ in parts], axis=0).reshape(bt, by)
+            if labelled:
+                self.ones += np.sum([o for _, o in parts], axis=0).reshape(bt, by)
+        return self
+
+
+def sample(x, times, start=0):
+    """x linearly interpolated at absolute (fractional) sample times"""
+    return np.interp(np.asarray(times) - start, np.arange(len(x)), x)
+
+
+def symbol_times(sps, phase, start, stop):
+    """Absolute symbol centre times phase + k * sps inside [start, stop - 1]"""
+    k0 = max(math.ceil((start - phase) / sps), 0)
+    k1 = math.floor((stop - 1 - phase) / sps)
+    k = np.arange(k0, k1 + 1)
+    return k, phase + k * sps
+
+
+def q_factor(values, threshold):
+    """(Q, BER estimate) of symbol-centre values split at threshold"""
+    values = np.asarray(values, np.float64)
+    high, low = values[values >= threshold], values[values < threshold]
+    if len(high) < 2 or len(low) < 2:
+        return 0.0, 0.5
+    q = (high.mean() - low.mean()) / (high.std() + low.std() + 1e-30)
+    return q, 0.5 * math.erfc(q / math.sqrt(2))
+
+
+def best_phase(x, sps, threshold, steps=32):
+    """Sampling phase in [0, sps) with the largest Q factor"""
+    phases = np.arange(steps) * (sps / steps)
+    qs = [q_factor(sample(x, symbol_times(sps, p, 0, len(x))[1]), threshold)[0] for p in phases]
+    return float(phases[int(np.argmax(qs))])
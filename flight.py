@@ -0,0 +1,107 @@
+# -*- coding: utf-8 -*-
+"""
+Flight recorder: keeps the seconds before an event.
+
+History lives in the acquisition ring (RAM). When the requested depth is
+larger than RAM_BYTES, a preallocated file on disk is used as a second,
+deeper ring which a spill thread keeps filled from the RAM ring. mark()
+only queues the event; a dump thread waits for the post-trigger samples,
+copies the window out of the rings and writes it as a binary capture, so
+acquisition never pauses.
+"""
+
+import os
+import pathlib
+import time
+from queue import Queue
+from threading import Event, Thread
+
+import numpy as np
+
+import acquire
+import capture
+
+RAM_BYTES = 256 << 20
+
+
+def preallocate(path, n, dtype):
+    """Memory map a file of n samples, reserving its blocks up front"""
+    size = n * np.dtype(dtype).itemsize
+    with open(path, 'wb') as f:
+        f.truncate(size)
+        try:
+            os.posix_fallocate(f.fileno(), 0, size)
+        except (AttributeError, OSError):
+            pass  # not available here; the truncate above still sizes the file
+    return np.memmap(path, dtype=dtype, mode='r+', shape=(n,))
+
+
+class FlightRecorder:
+    """Dumps [event - pre, event + post] of the live stream to capture files"""
+
+    def __init__(self, ring, acq, pre, post, directory):
+        self.ring = ring
+        self.acq = acq
+        self.pre = int(pre * acq.rate)
+        self.post = int(post * acq.rate)
+        self.directory = pathlib.Path(directory)
+        self.directory.mkdir(parents=True, exist_ok=True)
+        self.stopping = Event()
+        self.jobs = Queue()
+        self.written = Queue()  # (path, samples lost) of every dump
+
+        self.spill = None
+        depth = self.pre + self.post
+        if depth > ring.capacity and depth * ring.dtype.itemsize > RAM_BYTES:
+            buf = preallocate(self.directory / 'history.ring', depth, ring.dtype)
+            head = ring.head
+            self.spill = acquire.RingBuffer(depth, ring.dtype, buf=buf, head=head)
+            Thread(target=self._spill, args=(head,), daemon=True).start()
+        self.thread = Thread(target=self._dump_loop, daemon=True)
+        self.thread.start()
+
+    def _spill(self, head):
+        for start, data, lost in acquire.follow(self.ring, head, self.stopping):
+            if lost:
+                self.spill.skip(lost)
+            self.spill.write(data)
+
+    def mark(self, index=None, reason='manual'):
+        """Queue a dump around absolute sample index (now by default)"""
+        self.jobs.put((self.ring.head if index is None else index, reason))
+
+    def window(self, start, end):
+        """(first index, samples) for [start, end), RAM first, then the disk ring"""
+        data, _, lost = self.ring.read(start, end - start)
+        if lost and self.spill is not None:
+            # the spill thread may not have copied the older part out of RAM yet
+            while self.spill.head < start + lost and not self.stopping.is_set():
+                time.sleep(0.01)
+            older, _, gone = self.spill.read(start, lost)
+            if gone + len(older) == lost:
+                return start + gone, np.concatenate((older, data))
+        # anything short of contiguous is reported as lost from the front
+        return start + lost, data
+
+    def _dump_loop(self):
+        while True:
+            job = self.jobs.get()
+            if job is None:
+                break
+            index, reason = job
+            end = index + self.post
+            while self.ring.head < end and not self.stopping.is_set():
+                time.sleep(0.01)
+            start = max(index - self.pre, 0)
+            first, data = self.window(start, min(end, self.ring.head))
+            t = self.acq.time_of(first)
+            name = "event_%s_%03d_%s%s" % (time.strftime('%Y%m%d_%H%M%S', time.localtime(t)),
+                                           int(t * 1000) % 1000, reason, capture.SUFFIX)
+            path = self.directory / name
+            capture.save_binary(path, data, self.acq.rate, t)
+            self.written.put((str(path), first - start))
+
+    def close(self):
+        self.stopping.set()
+        self.jobs.put(None)
+        self.thread.join()
@@ -0,0 +1,109 @@
+# -*- coding: utf-8 -*-
+"""
+Chunked HDF5 import/export of sample datasets.
+
+Samples are a 1-D dataset chunked at pyramid.TILE samples, so a zoomed
+window maps onto whole chunks and a partial read touches only the chunks
+under it. Chunks carry the standard deflate filter, so any HDF5 reader can
+open the file, but the compression is done here: zlib runs on worker
+threads (it releases the GIL) and the finished chunks are written with
+write_direct_chunk. Reads fetch raw chunks and inflate them in parallel the
+same way. Files using other filters are read through h5py as usual.
+
+h5py is optional and only needed here.
+"""
+
+import zlib
+
+import numpy as np
+
+import pyramid
+from workers import WORKERS, map_chunks
+
+try:
+    import h5py
+except ImportError:
+    h5py = None
+
+SUFFIXES = ('.h5', '.hdf5')
+DATASET = 'samples'
+LEVEL = 4
+
+
+def _require():
+    if h5py is None:
+        raise RuntimeError("HDF5 support needs h5py (pip install h5py)")
+
+
+def save(path, samples, rate=0.0, start=0.0, chunk=pyramid.TILE, level=LEVEL):
+    """Write samples as a deflate-compressed, TILE-chunked dataset"""
+    _require()
+    dtype = np.dtype(samples.dtype).newbyteorder('<')
+    n = len(samples)
+    count = -(-n // chunk)
+
+    def compress(a, b):
+        out = []
+        for i in range(a, b):
+            block = np.zeros(chunk, dtype)  # stored chunks are always whole
+            part = samples[i * chunk:(i + 1) * chunk]
+            block[:len(part)] = part
+            out.append(zlib.compress(block.tobytes(), level))
+        return out
+
+    with h5py.File(path, 'w') as f:
+        d = f.create_dataset(DATASET, shape=(n,), dtype=dtype, chunks=(chunk,) if n else None,
+                             compression='gzip' if n else None, compression_opts=level if n else None)
+        d.attrs['rate'] = rate
+        d.attrs['start'] = start
+        # a few chunks per worker at a time bounds the memory held
+        step = WORKERS * 4
+        for first in range(0, count, step):
+            parts = map_chunks(lambda a, b: compress(first + a, first + b), min(step, count - first), 1)
+            for k, data in enumerate(c for p in parts for c in p):
+                d.id.write_direct_chunk(((first + k) * chunk,), data)
+
+
+def _direct(d):
+    # only plain deflate chunks can be inflated here
+    return (d.chunks is not None and d.compression == 'gzip' and not d.shuffle
+            and not d.fletcher32 and d.scaleoffset is None)
+
+
+def _read(d, start, stop):
+    n = d.shape[0]
+    start, stop = max(int(start), 0), min(int(n if stop is None else stop), n)
+    if stop <= start:
+        return np.empty(0, d.dtype)
+    if not _direct(d):
+        return d[start:stop]
+    chunk = d.chunks[0]
+    i0, i1 = start // chunk, -(-stop // chunk)
+    raw = [d.id.read_direct_chunk((i * chunk,)) for i in range(i0, i1)]
+
+    def inflate(a, b):
+        # bit 0 of the filter mask set means deflate was skipped for that chunk
+        return [np.frombuffer(data if mask & 1 else zlib.decompress(data), d.dtype) for mask, data in raw[a:b]]
+
+    blocks = [c for part in map_chunks(inflate, len(raw), 1) for c in part]
+    return np.concatenate(blocks)[start - i0 * chunk:stop - i0 * chunk]
+
+
+def read(path, start=0, stop=None):
+    """Samples [start, stop) reading and inflating only the chunks they span"""
+    _require()
+    with h5py.File(path, 'r') as f:
+        return _read(f[DATASET], start, stop)
+
+
+def info(path):
+    """(dtype, rate, start, count) of a samples dataset"""
+    _require()
+    with h5py.File(path, 'r') as f:
+        d = f[DATASET]
+        return d.dtype.name, float(d.attrs.get('rate', 0.0)), float(d.attrs.get('start', 0.0)), d.shape[0]
+
+
+def load(path):
+    """Whole dataset as a sample array"""
+    return read(path)
@@ -0,0 +1,90 @@
+# -*- coding: utf-8 -*-
+"""
+User analysis hooks over decoded results.
+
+A hook is a Python script defining
+
+    def on_batch(events):   # numpy structured array, decoders.ANNOTATION
+        return events[(events['flags'] & 1) != 0]   # optional findings
+
+and optionally on_end() returning a summary. Events are coalesced into large
+columnar batches and handed to the script on a worker thread, so a hook
+costs one Python call per batch instead of one per event. The queue in front
+of the worker is bounded: a slow hook stalls the decoders, not the UI.
+"""
+
+import importlib.util
+import pathlib
+from queue import Queue
+from threading import Thread
+
+import numpy as np
+
+import decoders
+
+BATCH_ROWS = 1 << 16
+
+
+def load_hook(path):
+    """Import a hook script, it must define on_batch(events)"""
+    path = pathlib.Path(path)
+    spec = importlib.util.spec_from_file_location('hook_' + path.stem, path)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    if not callable(getattr(module, 'on_batch', None)):
+        raise ValueError("%s does not define on_batch(events)" % path)
+    return module
+
+
+class HookRunner:
+    """Feeds coalesced event batches to a hook on its own thread"""
+
+    def __init__(self, hook, rows=BATCH_ROWS, depth=4):
+        self.hook = hook
+        self.rows = rows
+        self.queue = Queue(maxsize=depth)
+        self.findings = []
+        self.summary = None
+        self.error = None
+        self.thread = Thread(target=self._run, daemon=True)
+        self.thread.start()
+
+    def _call(self, pending):
+        events = np.concatenate(pending)
+        found = self.hook.on_batch(events)
+        if found is not None and len(found):
+            self.findings.append(np.asarray(found))
+
+    def _run(self):
+        pending, count, done = [], 0, False
+        try:
+            while not done:
+                batch = self.queue.get()
+                done = batch is None
+                if not done:
+                    pending.append(batch)
+                    count += len(batch)
+                if pending and (done or count >= self.rows):
+                    self._call(pending)
+                    pending, count = [], 0
+            if callable(getattr(self.hook, 'on_end', None)):
+                self.summary = self.hook.on_end()
+        except Exception as e:
+            self.error = e
+            # keep draining so producers blocked on put() can finish
+            while not done:
+                done = self.queue.get() is None
+
+    def put(self, batch):
+        """Queue one batch; blocks while the hook is behind"""
+        if len(batch):
+            self.queue.put(batch)
+
+    def close(self):
+        """Flush and wait for the hook, return (findings, summary)"""
+        self.queue.put(None)
+        self.thread.join()
+        if self.error is not None:
+            raise self.error
+        found = np.concatenate(self.findings) if self.findings else decoders.annotations()
+        return found, self.summary
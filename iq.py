@@ -0,0 +1,112 @@
+# -*- coding: utf-8 -*-
+"""
+IQ constellation and EVM analysis for demodulated QAM/PSK signals.
+
+The capture is read as interleaved I/Q words. Symbol timing is recovered
+blockwise with the feedforward Oerder-Meyr (square-law) estimator, so every
+block is independent and the whole capture is processed in parallel.
+"""
+
+import numpy as np
+
+from workers import map_chunks
+
+CONSTELLATIONS = {
+    'BPSK': np.array([-1, 1], dtype=np.complex64),
+    'QPSK': np.array([1 + 1j, -1 + 1j, -1 - 1j, 1 - 1j], dtype=np.complex64) / np.sqrt(2),
+    '16QAM': (np.add.outer(np.arange(-3, 4, 2), 1j * np.arange(-3, 4, 2)).ravel()
+              / np.sqrt(10)).astype(np.complex64),
+}
+
+# phase recovery uses the M-th power of the symbols
+POWER = {'BPSK': 2, 'QPSK': 4, '16QAM': 4}
+
+
+def to_iq(samples):
+    """Interleaved I/Q words to complex samples with DC removed"""
+    n = len(samples) // 2 * 2
+    i = samples[0:n:2].astype(np.float32)
+    q = samples[1:n:2].astype(np.float32)
+    iq = np.empty(n // 2, dtype=np.complex64)
+    iq.real = i - i.mean()
+    iq.imag = q - q.mean()
+    return iq
+
+
+def timing_offset(iq, sps, start=0):
+    """Oerder-Meyr estimate of the best sampling offset in [0, sps)"""
+    n = np.arange(start, start + len(iq))
+    power = iq.real ** 2 + iq.imag ** 2
+    x = np.sum(power * np.exp(-2j * np.pi * n / sps))
+    return (-np.angle(x) / (2 * np.pi) * sps) % sps
+
+
+def recover_symbols(iq, sps, block=4096):
+    """Resample iq at the recovered symbol instants, block symbols at a time"""
+    span = int(block * sps)
+
+    def work(s, e):
+        tau = timing_offset(iq[s:e], sps, s)
+        k0 = np.ceil((s - tau) / sps)
+        t = tau + sps * np.arange(k0, np.floor((e - 1 - tau) / sps) + 1)
+        t = t[(t >= s) & (t < len(iq) - 1)]
+        i0 = t.astype(np.int64)
+        frac = (t - i0).astype(np.float32)
+        return iq[i0] * (1 - frac) + iq[i0 + 1] * frac
+
+    parts = map_chunks(work, len(iq), span)
+    return np.concatenate(parts) if parts else np.empty(0, np.complex64)
+
+
+def normalize(symbols, modulation):
+    """Remove gain and carrier phase so symbols sit on the reference grid"""
+    ref = CONSTELLATIONS[modulation]
+    m = POWER[modulation]
+    phase = (np.angle(np.sum(symbols.astype(np.complex128) ** m))
+             - np.angle(np.sum(ref.astype(np.complex128) ** m))) / m
+    gain = np.sqrt(np.mean(np.abs(ref) ** 2) / max(np.mean(np.abs(symbols) ** 2), 1e-30))
+    return (symbols * np.complex64(gain * np.exp(-1j * phase))).astype(np.complex64)
+
+
+def decide(symbols, modulation, block=1 << 16):
+    """Nearest reference point for every symbol"""
+    ref = CONSTELLATIONS[modulation]
+
+    def work(s, e):
+        d = np.abs(symbols[s:e, None] - ref[None, :])
+        return ref[np.argmin(d, axis=1)]
+
+    parts = map_chunks(work, len(symbols), block)
+    return np.concatenate(parts) if parts else np.empty(0, np.complex64)
+
+
+def evm(symbols, modulation):
+    """EVM (rms and peak, percent) and MER (dB) of normalized symbols"""
+    ideal = decide(symbols, modulation)
+    err = np.abs(symbols - ideal) ** 2
+    ref_power = np.mean(np.abs(CONSTELLATIONS[modulation]) ** 2)
+    err_power = max(float(np.mean(err)), 1e-30)
+    return {
+        'evm_rms': 100 * np.sqrt(err_power / ref_power),
+        'evm_peak': 100 * np.sqrt(float(np.max(err)) / ref_power),
+        'mer_db': 10 * np.log10(float(np.sum(np.abs(ideal) ** 2)) / (err_power * len(err))),
+    }
+
+
+def density(symbols, bins=256, span=1.5, block=1 << 20):
+    """2-D histogram of the constellation, accumulated in parallel"""
+    edges = np.linspace(-span, span, bins + 1)
+
+    def work(s, e):
+        h, _, _ = np.histogram2d(symbols.real[s:e], symbols.imag[s:e], bins=(edges, edges))
+        return h
+
+    parts = map_chunks(work, len(symbols), block)
+    return np.sum(parts, axis=0) if parts else np.zeros((bins, bins)), edges
+
+
+def analyze(samples, sps, modulation='QPSK'):
+    """Full pipeline from raw interleaved words to symbols, density and EVM"""
+    symbols = normalize(recover_symbols(to_iq(samples), sps), modulation)
+    hist, edges = density(symbols)
+    return symbols, hist, edges, evm(symbols, modulation)
@@ -0,0 +1,208 @@
+# -*- coding: utf-8 -*-
+"""
+Memory governor for derived data.
+
+Caches (loaded captures, pyramids, decoder outputs) register what they hold
+with the global GOVERNOR together with the time it took to build. When the
+total passes the budget the entry with the lowest priority is evicted,
+priority being a running clock plus rebuild seconds per byte
+(GreedyDual-Size): stale entries go first, and of equally stale ones the
+big, cheap ones. Arrays and objects with save/load are spilled to the disk
+cache instead of dropped, and come back from there (arrays memory mapped)
+on the next get. Memory-mapped captures count as nothing; their pages
+belong to the OS. Values still referenced outside the cache are passed over,
+since dropping them would free nothing.
+"""
+
+import atexit
+import ctypes
+import itertools
+import os
+import pathlib
+import sys
+import time
+from threading import RLock
+
+import numpy as np
+
+FRACTION = 0.25  # of physical memory, when no budget is given
+SPILL = pathlib.Path(__file__).parent / 'cache'
+HELD = 2  # references to a cached value from the cache itself (entry + getrefcount's argument)
+
+
+class _MemoryStatus(ctypes.Structure):
+    # MEMORYSTATUSEX
+    _fields_ = [('dwLength', ctypes.c_uint32), ('dwMemoryLoad', ctypes.c_uint32),
+                ('ullTotalPhys', ctypes.c_uint64), ('ullAvailPhys', ctypes.c_uint64),
+                ('ullTotalPageFile', ctypes.c_uint64), ('ullAvailPageFile', ctypes.c_uint64),
+                ('ullTotalVirtual', ctypes.c_uint64), ('ullAvailVirtual', ctypes.c_uint64),
+                ('ullAvailExtendedVirtual', ctypes.c_uint64)]
+
+
+def physical():
+    """Installed RAM in bytes"""
+    if sys.platform == 'win32':
+        status = _MemoryStatus()
+        status.dwLength = ctypes.sizeof(status)
+        if ctypes.windll.kernel32.GlobalMemoryStatusEx(ctypes.byref(status)):
+            return status.ullTotalPhys
+    else:
+        try:
+            return os.sysconf('SC_PAGE_SIZE') * os.sysconf('SC_PHYS_PAGES')
+        except (AttributeError, ValueError, OSError):
+            pass
+    return 4 << 30  # unknown; assume a small machine
+
+
+def footprint(value):
+    """Bytes a cached value holds in RAM"""
+    if isinstance(value, np.memmap):
+        return 0
+    if isinstance(value, np.ndarray):
+        return value.nbytes
+    if isinstance(value, (tuple, list)):
+        return sum(footprint(v) for v in value)
+    if hasattr(value, 'nbytes'):
+        return int(value.nbytes)
+    return sys.getsizeof(value)
+
+
+class Entry:
+    __slots__ = ('value', 'nbytes', 'cost', 'priority', 'path', 'kind')
+
+    def __init__(self, value, nbytes, cost):
+        self.value = value
+        self.nbytes = nbytes
+        self.cost = cost
+        self.priority = 0.0
+        self.path = None
+        self.kind = None
+
+
+class Governor:
+    """Budgeted cache of rebuildable values with cost-aware LRU eviction"""
+
+    def __init__(self, budget=None, directory=SPILL):
+        self.budget = int(budget or physical() * FRACTION)
+        self.directory = pathlib.Path(directory) if directory is not None else None
+        self.entries = {}
+        self.used = 0
+        self.clock = 0.0
+        self.hits = self.misses = self.evictions = self.spills = 0
+        self.serial = itertools.count()
+        self.lock = RLock()  # caches are filled from worker threads too
+
+    def key(self, kind):
+        """A fresh key for a cache that has no natural one"""
+        return kind, next(self.serial)
+
+    def _touch(self, e):
+        e.priority = self.clock + e.cost / max(e.nbytes, 1)
+
+    def register(self, key, value, cost=0.0, nbytes=None):
+        """Hold value under key; cost is the seconds it took to build"""
+        with self.lock:
+            self.discard(key)
+            e = Entry(value, footprint(value) if nbytes is None else nbytes, cost)
+            self._touch(e)
+            self.entries[key] = e
+            self.used += e.nbytes
+            self._evict(0)
+            return value
+
+    def get(self, key, default=None):
+        with self.lock:
+            e = self.entries.get(key)
+            if e is None:
+                self.misses += 1
+                return default
+            self.hits += 1
+            if e.value is None:
+                e.value = self._restore(e)
+                e.nbytes = footprint(e.value)
+                self.used += e.nbytes
+            self._touch(e)
+            self._evict(0)
+            return e.value
+
+    def cached(self, key, build):
+        """get(key), or build() timed and registered"""
+        value = self.get(key)
+        if value is None:
+            t = time.perf_counter()
+            value = self.register(key, build(), time.perf_counter() - t)
+        return value
+
+    def reserve(self, nbytes):
+        """Evict until nbytes more fits in the budget; False, evicting nothing, if it never can"""
+        with self.lock:
+            if nbytes > self.budget:
+                return False
+            return self._evict(nbytes)
+
+    def discard(self, key):
+        with self.lock:
+            e = self.entries.pop(key, None)
+            if e is not None:
+                if e.value is not None:
+                    self.used -= e.nbytes
+                self._unlink(e)
+
+    def clear(self):
+        with self.lock:
+            for key in list(self.entries):
+                self.discard(key)
+
+    def usage(self):
+        with self.lock:
+            spilled = sum(e.value is None for e in self.entries.values())
+            return {'used': self.used, 'budget': self.budget, 'entries': len(self.entries), 'spilled': spilled,
+                    'evictions': self.evictions, 'spills': self.spills,
+                    'hit_rate': self.hits / max(self.hits + self.misses, 1)}
+
+    def _evict(self, extra):
+        while self.used + extra > self.budget:
+            # a value still referenced outside the cache frees nothing when dropped
+            resident = [e for e in self.entries.values()
+                        if e.value is not None and e.nbytes and sys.getrefcount(e.value) <= HELD]
+            if not resident:
+                return False
+            e = min(resident, key=lambda r: r.priority)
+            self.clock = e.priority
+            if self.directory is not None and self._spill(e):
+                self.spills += 1
+            self.evictions += 1
+            e.value = None
+            self.used -= e.nbytes
+        self.entries = {k: e for k, e in self.entries.items() if e.value is not None or e.path is not None}
+        return True
+
+    def _spill(self, e):
+        if isinstance(e.value, np.ndarray) and e.value.dtype != object:
+            suffix = '.npy'
+        elif hasattr(e.value, 'save') and hasattr(type(e.value), 'load'):
+            suffix = '.npz'
+        else:
+            return False
+        if e.path is None:
+            self.directory.mkdir(parents=True, exist_ok=True)
+            e.path = self.directory / ('spill-%d-%d%s' % (os.getpid(), next(self.serial), suffix))
+            if suffix == '.npy':
+                np.save(e.path, e.value)
+            else:
+                e.value.save(e.path)
+            e.kind = type(e.value)
+        return True
+
+    def _restore(self, e):
+        if e.path.suffix == '.npy':
+            return np.load(e.path, mmap_mode='r')
+        return e.kind.load(e.path)
+
+    def _unlink(self, e):
+        if e.path is not None:
+            pathlib.Path(e.path).unlink(missing_ok=True)
+
+
+GOVERNOR = Governor()
+atexit.register(GOVERNOR.clear)
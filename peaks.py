@@ -0,0 +1,127 @@
+# -*- coding: utf-8 -*-
+"""
+Spectral peak search over an averaged spectrum.
+
+The Averager keeps a running power average of Hann-windowed frames and takes
+samples as they come, so in live mode only the new frames are transformed.
+Peaks are local maxima standing above a fixed threshold or, without one, a
+margin over the local noise floor (a median per band of bins, interpolated);
+a parabola through the log magnitude of the three top bins gives the true
+frequency and amplitude. Peaks are then labelled as the fundamental, its (aliased)
+harmonics, or spurs, in a structured array that sorts on any column.
+"""
+
+import numpy as np
+
+FRAME = 4096
+PEAK = np.dtype([('frequency', 'f8'), ('level_db', 'f8'), ('dbc', 'f8'),
+                 ('above_floor', 'f8'), ('harmonic', 'i4')])
+COLUMNS = PEAK.names
+# Hann scalloping and equivalent noise bandwidth are folded into the levels
+HANN_GAIN = 0.5
+
+
+class Averager:
+    """Running average of power spectra over FRAME-sample Hann frames
+
+    depth 0 averages every frame seen; otherwise the average is exponential
+    with a time constant of depth frames.
+    """
+
+    def __init__(self, rate, frame=FRAME, depth=0):
+        self.rate = rate
+        self.frame = frame
+        self.depth = depth
+        self.window = np.hanning(frame)
+        self.tail = np.empty(0, np.float64)
+        self.power = np.zeros(frame // 2 + 1)
+        self.frames = 0
+
+    def feed(self, samples):
+        """Add the whole frames now available; returns how many were added"""
+        x = np.concatenate((self.tail, np.asarray(samples, np.float64)))
+        count = len(x) // self.frame
+        self.tail = x[count * self.frame:]
+        if not count:
+            return 0
+        f = x[:count * self.frame].reshape(count, self.frame)
+        F = np.fft.rfft((f - f.mean(axis=1, keepdims=True)) * self.window, axis=1)
+        p = F.real ** 2 + F.imag ** 2
+        if self.depth:
+            a = 1.0 / self.depth
+            # k frames of exponential averaging in one step
+            weights = a * (1 - a) ** np.arange(count - 1, -1, -1)
+            self.power = self.power * (1 - a) ** count + weights @ p
+        else:
+            self.power = (self.power * self.frames + p.sum(axis=0)) / (self.frames + count)
+        self.frames += count
+        return count
+
+    def spectrum(self):
+        """(frequencies in Hz, amplitude in dB of a full-scale-equivalent sine)"""
+        scale = (self.frame * HANN_GAIN / 2) ** 2
+        return (np.fft.rfftfreq(self.frame, 1 / self.rate),
+                10 * np.log10(self.power / scale + 1e-30))
+
+
+def noise_floor(db, band=64):
+    """Median level per band of bins, linearly interpolated across bins"""
+    n = len(db) // band * band
+    if n < band:
+        return np.full(len(db), np.median(db))
+    medians = np.median(db[:n].reshape(-1, band), axis=1)
+    centres = np.arange(len(medians)) * band + band / 2
+    return np.interp(np.arange(len(db)), centres, medians)
+
+
+def find(freq, db, threshold=None, margin=10.0, band=64, limit=100):
+    """Peaks (PEAK array, strongest first) above threshold dB if given, else above floor + margin"""
+    floor = noise_floor(db, band)
+    level = floor + margin if threshold is None else np.full_like(floor, threshold)
+    i = np.flatnonzero((db[1:-1] > db[:-2]) & (db[1:-1] >= db[2:]) & (db[1:-1] > level[1:-1])) + 1
+    i = i[np.argsort(db[i])[::-1][:limit]]
+    a, b, c = db[i - 1], db[i], db[i + 1]
+    den = a - 2 * b + c
+    frac = np.where(den != 0, 0.5 * (a - c) / np.where(den != 0, den, 1), 0.0)
+    out = np.zeros(len(i), PEAK)
+    step = freq[1] - freq[0] if len(freq) > 1 else 0.0
+    out['frequency'] = freq[i] + frac * step
+    out['level_db'] = b - 0.25 * (a - c) * frac
+    out['above_floor'] = out['level_db'] - floor[i]
+    if len(out):
+        out['dbc'] = out['level_db'] - out['level_db'][0]
+    return out
+
+
+def alias(f, rate):
+    """Frequency f as seen after sampling at rate"""
+    f = np.mod(f, rate)
+    return np.where(f > rate / 2, rate - f, f)
+
+
+def classify(peaks, rate, resolution, harmonics=10):
+    """Label the strongest peak 1 and its harmonics 2..harmonics; spurs stay 0"""
+    peaks['harmonic'] = 0
+    if not len(peaks):
+        return peaks
+    f0 = peaks['frequency'][0]
+    peaks['harmonic'][0] = 1
+    for h in range(2, harmonics + 1):
+        near = np.abs(peaks['frequency'] - alias(h * f0, rate)) <= 2 * resolution
+        near &= peaks['harmonic'] == 0
+        if near.any():
+            peaks['harmonic'][np.flatnonzero(near)[0]] = h
+    return peaks
+
+
+def search(averager, threshold=None, margin=10.0, harmonics=10):
+    """(frequencies, dB, classified peaks) of an Averager's current spectrum"""
+    freq, db = averager.spectrum()
+    found = find(freq, db, threshold, margin)
+    return freq, db, classify(found, averager.rate, averager.rate / averager.frame, harmonics)
+
+
+def table(peaks, column='level_db', descending=True):
+    """Peak table sorted on one column"""
+    order = np.argsort(peaks[column], kind='stable')
+    return peaks[order[::-1] if descending else order]
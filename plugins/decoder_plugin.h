@@ -0,0 +1,150 @@
+/*
+ * Porta-Scope streaming decoder plugin ABI.
+ *
+ * A plugin is a shared object exporting ps_decoder_entry(). The host hands it
+ * batches straight out of its numpy buffers (no copies) and collects the
+ * annotations it writes into a host-owned output array. Decoders stack: the
+ * annotations of one decoder are the input batch of the next.
+ *
+ * Build: g++ -O2 -shared -fPIC -o framing.so example_framing.cpp
+ */
+
+#ifndef PORTA_SCOPE_DECODER_PLUGIN_H
+#define PORTA_SCOPE_DECODER_PLUGIN_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PS_DECODER_ABI_VERSION 1
+
+/* input/output stream kinds, mirrored by decoders.STREAMS */
+enum ps_stream {
+    PS_STREAM_U16 = 0,          /* raw samples, uint16 */
+    PS_STREAM_I16 = 1,          /* raw samples, int16 */
+    PS_STREAM_U32 = 2,          /* raw samples, uint32 */
+    PS_STREAM_LOGIC = 3,        /* sliced samples, uint8 0/1 */
+    PS_STREAM_ANNOTATIONS = 4   /* ps_annotation records */
+};
+
+/* same layout as decoders.ANNOTATION (numpy, align=True) */
+typedef struct ps_annotation {
+    int64_t start;      /* first sample index */
+    int64_t end;        /* last sample index */
+    int64_t value;      /* decoded value (byte, word, message id ...) */
+    uint16_t kind;      /* PS_KIND_* or a plugin defined id >= PS_KIND_USER */
+    uint16_t flags;     /* PS_FLAG_* */
+} ps_annotation;
+
+enum ps_kind {
+    PS_KIND_EDGE = 0,
+    PS_KIND_BYTE = 1,
+    PS_KIND_FRAME = 2,
+    PS_KIND_GLITCH = 3,
+    PS_KIND_MEASUREMENT = 4,
+    PS_KIND_USER = 256
+};
+
+enum ps_flag {
+    PS_FLAG_ERROR = 1 << 0,     /* framing, parity or CRC failure */
+    PS_FLAG_START = 1 << 1,     /* first item of a frame */
+    PS_FLAG_END = 1 << 2        /* last item of a frame */
+};
+
+typedef struct ps_decoder {
+    uint32_t abi_version;       /* PS_DECODER_ABI_VERSION */
+    const char *name;
+    uint32_t input;             /* enum ps_stream */
+    uint32_t output;            /* always PS_STREAM_ANNOTATIONS */
+
+    /* options is a NUL terminated "key=value;key=value" string, may be empty */
+    void *(*create)(const char *options);
+    void (*destroy)(void *state);
+
+    /*
+     * Consume the next n input items of the stream (sample indices are
+     * counted by the plugin from 0) and write at most out_cap annotations
+     * to out. Returns the number written, or -1 on error. When the return
+     * value equals out_cap the host calls again with n == 0 to drain what
+     * is still pending.
+     */
+    int64_t (*decode)(void *state, const void *in, int64_t n,
+                      ps_annotation *out, int64_t out_cap);
+} ps_decoder;
+
+typedef const ps_decoder *(*ps_decoder_entry_fn)(void);
+
+#ifdef __cplusplus
+}
+
+#include <deque>
+#include <string>
+
+namespace ps {
+
+/*
+ * Thin C++ helper: derive from Decoder<T>, implement
+ *     void decode(const In *in, int64_t n)
+ * calling emit() for every annotation, then export with PS_DECODER_EXPORT.
+ * Buffering of output beyond out_cap is handled here.
+ */
+template <typename Derived, typename In>
+class Decoder {
+public:
+    explicit Decoder(const std::string &options) : options_(options) {}
+    virtual ~Decoder() {}
+
+    void emit(int64_t start, int64_t end, int64_t value, uint16_t kind, uint16_t flags = 0)
+    {
+        ps_annotation a = {start, end, value, kind, flags};
+        pending_.push_back(a);
+    }
+
+    const std::string &options() const { return options_; }
+
+    static void *create(const char *options)
+    {
+        return new Derived(options ? options : "");
+    }
+
+    static void destroy(void *state)
+    {
+        delete static_cast<Derived *>(state);
+    }
+
+    static int64_t decode(void *state, const void *in, int64_t n, ps_annotation *out, int64_t out_cap)
+    {
+        Derived *self = static_cast<Derived *>(state);
+        if (n > 0)
+            self->decode(static_cast<const In *>(in), n);
+        int64_t count = 0;
+        while (count < out_cap && !self->pending_.empty()) {
+            out[count++] = self->pending_.front();
+            self->pending_.pop_front();
+        }
+        return count;
+    }
+
+private:
+    std::string options_;
+    std::deque<ps_annotation> pending_;
+};
+
+}  // namespace ps
+
+#define PS_DECODER_EXPORT(Class, In, name, input)                                   \
+    extern "C" const ps_decoder *ps_decoder_entry(void)                             \
+    {                                                                               \
+        static const ps_decoder d = {PS_DECODER_ABI_VERSION, name, input,           \
+                                     PS_STREAM_ANNOTATIONS,                         \
+                                     &ps::Decoder<Class, In>::create,               \
+                                     &ps::Decoder<Class, In>::destroy,              \
+                                     &ps::Decoder<Class, In>::decode};              \
+        return &d;                                                                  \
+    }
+
+#endif /* __cplusplus */
+
+#endif /* PORTA_SCOPE_DECODER_PLUGIN_H */
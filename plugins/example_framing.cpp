@@ -0,0 +1,50 @@
+/*
+ * Example stacked decoder: groups UART bytes into frames delimited by a flag
+ * byte (0x7E by default, "flag=<n>" option to change it). Each frame becomes
+ * one PS_KIND_FRAME annotation whose value is the payload length; a byte with
+ * a framing error marks the whole frame with PS_FLAG_ERROR.
+ */
+
+#include <cstdlib>
+
+#include "decoder_plugin.h"
+
+class Framing : public ps::Decoder<Framing, ps_annotation> {
+public:
+    explicit Framing(const std::string &options)
+        : ps::Decoder<Framing, ps_annotation>(options), flag_(0x7E), start_(-1), length_(0), error_(false)
+    {
+        std::string::size_type at = options.find("flag=");
+        if (at != std::string::npos)
+            flag_ = std::strtol(options.c_str() + at + 5, 0, 0);
+    }
+
+    void decode(const ps_annotation *in, int64_t n)
+    {
+        for (int64_t i = 0; i < n; i++) {
+            const ps_annotation &b = in[i];
+            if (b.kind != PS_KIND_BYTE)
+                continue;
+            if (b.value == flag_) {
+                if (start_ >= 0 && length_ > 0)
+                    emit(start_, b.end, length_, PS_KIND_FRAME, error_ ? PS_FLAG_ERROR : 0);
+                start_ = b.start;
+                length_ = 0;
+                error_ = false;
+                continue;
+            }
+            if (start_ < 0)
+                continue;
+            length_++;
+            error_ = error_ || (b.flags & PS_FLAG_ERROR);
+        }
+    }
+
+private:
+    int64_t flag_;
+    int64_t start_;
+    int64_t length_;
+    bool error_;
+};
+
+PS_DECODER_EXPORT(Framing, ps_annotation, "framing", PS_STREAM_ANNOTATIONS)
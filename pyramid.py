@@ -0,0 +1,92 @@
+# -*- coding: utf-8 -*-
+"""
+Min/max decimation pyramid for drawing long captures.
+
+Level 0 holds the minimum and maximum of every BASE samples and each level
+above reduces FACTOR buckets of the one below. A view of any range at a
+given width reads the coarsest level that still has a bucket per point,
+so drawing costs about the same at every zoom. Level 0 is built in parallel
+TILE-sized chunks straight from the (possibly memory-mapped) samples.
+"""
+
+import numpy as np
+
+from workers import map_chunks
+
+BASE = 64
+FACTOR = 4
+TILE = BASE * 1024  # samples per level-0 tile of 1024 buckets
+
+
+def _reduce(lo, hi, factor):
+    n = len(lo) // factor * factor
+    lo2 = lo[:n].reshape(-1, factor).min(axis=1)
+    hi2 = hi[:n].reshape(-1, factor).max(axis=1)
+    if n < len(lo):
+        lo2 = np.append(lo2, lo[n:].min())
+        hi2 = np.append(hi2, hi[n:].max())
+    return lo2, hi2
+
+
+class Pyramid:
+    """levels[k] = (mins, maxs) over buckets of BASE * FACTOR**k samples"""
+
+    def __init__(self, levels, length, base=BASE, factor=FACTOR):
+        self.levels = levels
+        self.length = length
+        self.base = base
+        self.factor = factor
+
+    @classmethod
+    def build(cls, samples, base=BASE, factor=FACTOR):
+        def work(s, e):
+            return _reduce(np.asarray(samples[s:e]), np.asarray(samples[s:e]), base)
+
+        parts = map_chunks(work, len(samples), base * 1024)
+        if not parts:
+            return cls([], 0, base, factor)
+        lo = np.concatenate([p[0] for p in parts])
+        hi = np.concatenate([p[1] for p in parts])
+        levels = [(lo, hi)]
+        while len(levels[-1][0]) > 1:
+            levels.append(_reduce(*levels[-1], factor))
+        return cls(levels, len(samples), base, factor)
+
+    @property
+    def nbytes(self):
+        return sum(lo.nbytes + hi.nbytes for lo, hi in self.levels)
+
+    def bucket(self, level):
+        return self.base * self.factor ** level
+
+    def view(self, samples, start, stop, points=4096):
+        """(positions, mins, maxs) covering start..stop with about points buckets
+
+        Below one base bucket per point the raw samples are returned, with
+        mins and maxs both the sample values.
+        """
+        start, stop = max(int(start), 0), min(int(stop), self.length)
+        span = max(stop - start, 0)
+        if span <= points * self.base or not self.levels:
+            y = np.asarray(samples[start:stop])
+            return np.arange(start, stop), y, y
+        level = 0
+        while level + 1 < len(self.levels) and self.bucket(level + 1) * points <= span:
+            level += 1
+        size = self.bucket(level)
+        lo, hi = self.levels[level]
+        a, b = start // size, -(-stop // size)
+        return np.arange(a, b) * size, lo[a:b], hi[a:b]
+
+    def save(self, path):
+        arrays = {'meta': np.array([self.length, self.base, self.factor])}
+        for k, (lo, hi) in enumerate(self.levels):
+            arrays['lo%d' % k], arrays['hi%d' % k] = lo, hi
+        np.savez(path, **arrays)
+
+    @classmethod
+    def load(cls, path):
+        with np.load(path) as f:
+            length, base, factor = (int(v) for v in f['meta'])
+            levels = [(f['lo%d' % k], f['hi%d' % k]) for k in range((len(f.files) - 1) // 2)]
+        return cls(levels, length, base, factor)
@@ -0,0 +1,147 @@
+# -*- coding: utf-8 -*-
+"""
+Continuous record-to-disk from the acquisition ring buffer.
+
+A drain thread copies samples out of the ring into one of two large
+page-aligned buffers; when a buffer is full it is handed to the I/O thread,
+which writes it in a single call while the drain fills the other one. fsync
+is batched every SYNC_BYTES. Neither thread ever holds up the acquisition
+thread: if the disk falls so far behind that the ring laps the drain, the
+lost samples are counted as an overrun and listed in a sidecar file, and
+their place in the capture is left as zeros (a hole seeked over, not
+written) so every later sample keeps its time.
+"""
+
+import json
+import os
+import time
+from queue import Queue
+from threading import Event, Thread
+
+import numpy as np
+
+import capture
+
+BLOCK_BYTES = 4 << 20
+SYNC_BYTES = 64 << 20
+ALIGN = 4096
+
+
+def aligned(nbytes, align=ALIGN):
+    """Uninitialised uint8 buffer whose address is a multiple of align"""
+    raw = np.empty(nbytes + align, np.uint8)
+    off = (-raw.ctypes.data) % align
+    return raw[off:off + nbytes]
+
+
+class Recorder:
+    """Drains a ring buffer into a binary capture file"""
+
+    def __init__(self, ring, path, rate, start_pos=None, start_time=None,
+                 block_bytes=BLOCK_BYTES, sync_bytes=SYNC_BYTES):
+        self.ring = ring
+        self.path = str(path)
+        self.pos = ring.head if start_pos is None else start_pos
+        self.dtype = ring.dtype.newbyteorder('<')
+        self.sync_bytes = sync_bytes
+        self.written = 0        # samples on disk
+        self.overruns = []      # (sample index in file, samples lost and zeroed)
+        self.error = None
+        self.stopping = Event()
+
+        self.fd = os.open(self.path, os.O_WRONLY | os.O_CREAT | os.O_TRUNC | getattr(os, 'O_BINARY', 0))
+        os.write(self.fd, capture.pack_header(self.dtype, rate, time.time() if start_time is None else start_time))
+
+        self.items = block_bytes // self.dtype.itemsize
+        self.free = Queue()
+        self.full = Queue()
+        for _ in range(2):
+            self.free.put(aligned(self.items * self.dtype.itemsize).view(self.dtype))
+        self.drain_thread = Thread(target=self._drain, daemon=True)
+        self.io_thread = Thread(target=self._io, daemon=True)
+        self.drain_thread.start()
+        self.io_thread.start()
+
+    def _drain(self):
+        filled = queued = 0
+        buf = self.free.get()
+        while True:
+            stopping = self.stopping.is_set()
+            data, self.pos, lost = self.ring.read(self.pos, self.items - filled)
+            if lost:
+                if filled:
+                    self.full.put((buf, filled))
+                    queued += filled
+                    filled = 0
+                    buf = self.free.get()
+                self.overruns.append((queued, lost))
+                self.full.put((None, lost))  # a gap for the I/O thread to skip
+                queued += lost
+            buf[filled:filled + len(data)] = data
+            filled += len(data)
+            if filled == self.items or (stopping and filled):
+                self.full.put((buf, filled))
+                queued += filled
+                filled = 0
+                # waits only if the disk is two whole buffers behind; the ring absorbs that
+                buf = self.free.get()
+            if stopping and not len(data):
+                break
+            if not len(data):
+                time.sleep(0.002)
+        self.full.put(None)
+
+    def _io(self):
+        unsynced = 0
+        while True:
+            item = self.full.get()
+            if item is None:
+                break
+            buf, n = item
+            try:
+                if self.error is None and buf is None:
+                    os.lseek(self.fd, n * self.dtype.itemsize, os.SEEK_CUR)
+                elif self.error is None:
+                    view = memoryview(buf[:n]).cast('B')
+                    while len(view):
+                        view = view[os.write(self.fd, view):]
+                    self.written += n
+                    unsynced += n * self.dtype.itemsize
+                    if unsynced >= self.sync_bytes:
+                        os.fsync(self.fd)
+                        unsynced = 0
+            except OSError as e:
+                self.error = e  # keep draining so stop() still returns
+            if buf is not None:
+                self.free.put(buf)
+        if self.error is None:
+            # a gap at the very end is only a seek so far; extend the file over it
+            try:
+                os.ftruncate(self.fd, os.lseek(self.fd, 0, os.SEEK_CUR))
+            except OSError as e:
+                self.error = e
+
+    def stats(self):
+        """Samples written, samples lost to overruns, overrun count, backlog"""
+        return {
+            'written': self.written,
+            'lost': sum(n for _, n in self.overruns),
+            'overruns': len(self.overruns),
+            'backlog': self.ring.head - self.pos,
+        }
+
+    def stop(self):
+        """Flush what is left in the ring, close the file"""
+        self.stopping.set()
+        self.drain_thread.join()
+        self.io_thread.join()
+        try:
+            os.fsync(self.fd)
+        finally:
+            os.close(self.fd)
+        if self.overruns:
+            with open(self.path + '.overruns.json', 'w') as f:
+                json.dump(self.overruns, f)
+        if self.error is not None:
+            raise self.error
+        return self.stats()
@@ -0,0 +1,204 @@
+# -*- coding: utf-8 -*-
+"""
+Reference waveform slots and comparison against them.
+
+A slot holds a known-good trace in memory or on disk (a binary capture,
+memory-mapped back), with its min/max pyramid for overlays held by the
+memory governor. The reference is aligned to a capture once by
+cross-correlation on a background thread (align). After that the difference
+channel and the score of the visible range are computed on demand from just
+that range, and the summary over the whole capture is built from per-chunk
+sums on a background thread.
+"""
+
+import itertools
+import os
+import pathlib
+from threading import Thread
+
+import numpy as np
+
+import capture
+import delay
+import memory
+import pyramid
+from workers import map_chunks
+
+SLOTS = 4
+TRASH = '.deleted'  # cleared slot files still mapped elsewhere, removed later
+_trash = itertools.count()
+
+
+class Slot:
+    """One stored reference waveform"""
+
+    def __init__(self, samples, rate, path=None):
+        self.samples = samples
+        self.rate = rate
+        self.path = path
+        self.key = memory.GOVERNOR.key('reference pyramid')
+        self.pyramid  # build it now, overlays want it at once
+
+    @property
+    def pyramid(self):
+        """Min/max pyramid, rebuilt or reloaded if the governor evicted it"""
+        return memory.GOVERNOR.cached(self.key, lambda: pyramid.Pyramid.build(self.samples))
+
+    @classmethod
+    def store(cls, samples, rate, path=None):
+        """Keep a copy in memory, or write it to path and map it back"""
+        if path is None:
+            return cls(np.array(samples), rate)
+        capture.save_binary(path, np.asarray(samples), rate, 0.0)
+        return cls(capture.load_binary(path), rate, path)
+
+
+class Slots:
+    """Numbered reference slots; on-disk ones live in directory and survive restarts"""
+
+    def __init__(self, directory):
+        self.directory = pathlib.Path(directory)
+        self.slots = {}
+        self.sweep()
+        for i in range(1, SLOTS + 1):
+            path = self.file(i)
+            if path.exists():
+                self.slots[i] = Slot(capture.load_binary(path), capture.read_header(path)[1], path)
+
+    def file(self, index):
+        return self.directory / ('ref%d%s' % (index, capture.SUFFIX))
+
+    def store(self, index, samples, rate, disk=False):
+        self.clear(index)
+        path = None
+        if disk:
+            self.directory.mkdir(parents=True, exist_ok=True)
+            path = self.file(index)
+        self.slots[index] = Slot.store(samples, rate, path)
+        return self.slots[index]
+
+    def get(self, index):
+        return self.slots.get(index)
+
+    def clear(self, index):
+        slot = self.slots.pop(index, None)
+        if slot is None:
+            return
+        memory.GOVERNOR.discard(slot.key)
+        if slot.path is not None:
+            # drop this map; comparisons still holding the slot see it empty
+            slot.samples = np.empty(0, slot.samples.dtype)
+            path = pathlib.Path(slot.path)
+            try:
+                path.unlink(missing_ok=True)
+            except PermissionError:
+                # Windows will not delete a file another view still maps, but
+                # renames it, which frees the slot's name for a new reference
+                path.replace(path.with_name('%s-%d-%d%s' % (path.stem, os.getpid(), next(_trash), TRASH)))
+        self.sweep()
+
+    def sweep(self):
+        """Remove cleared slot files that are no longer mapped"""
+        for path in self.directory.glob('*' + TRASH):
+            try:
+                path.unlink()
+            except OSError:
+                pass
+
+
+def _sums(x, y):
+    x = np.asarray(x, np.float64)
+    y = np.asarray(y, np.float64)
+    d = x - y
+    return np.array([len(x), x.sum(), y.sum(), x @ x, y @ y, x @ y, d @ d, np.abs(d).max(initial=0.0)])
+
+
+def _score(s):
+    n, sx, sy, sxx, syy, sxy, sdd, peak = s
+    if n < 2:
+        return {'correlation': 0.0, 'rms': 0.0, 'peak': 0.0, 'samples': int(n)}
+    cov = sxy - sx * sy / n
+    var = (sxx - sx * sx / n) * (syy - sy * sy / n)
+    return {'correlation': cov / np.sqrt(var) if var > 0 else 0.0,
+            'rms': np.sqrt(sdd / n), 'peak': peak, 'samples': int(n)}
+
+
+class Compare:
+    """A capture against a reference slot, aligned by cross-correlation"""
+
+    def __init__(self, slot, samples, lag=None):
+        self.slot = slot
+        self.samples = samples
+        if lag is None:
+            # delay of the capture behind the reference
+            lag, self.alignment = delay.correlate(slot.samples, samples)
+        else:
+            self.alignment = None
+        self.lag = lag
+        self.shift = delay.FractionalDelay(lag)
+        self.summary = None
+
+    def reference(self, start, stop):
+        """The reference moved onto the capture's time axis, start..stop only"""
+        return self.shift.render(self.slot.samples, start, stop)
+
+    def difference(self, start, stop):
+        """Capture minus aligned reference over start..stop"""
+        stop = min(stop, len(self.samples))
+        return np.asarray(self.samples[start:stop], np.float64) - self.reference(start, stop)
+
+    def overlap(self):
+        """Range of the capture that the shifted reference covers"""
+        return max(0, int(np.ceil(self.lag))), min(len(self.samples), int(np.floor(self.lag)) + len(self.slot.samples))
+
+    def score(self, start, stop):
+        """Correlation, rms and peak difference over start..stop"""
+        lo, hi = self.overlap()
+        start, stop = max(start, lo), min(stop, hi)
+        if stop <= start:
+            return _score(np.zeros(8))
+        return _score(_sums(self.samples[start:stop], self.reference(start, stop)))
+
+    def summarize(self, done=None, chunk=1 << 20):
+        """Score of the whole overlap on a background thread; done(summary) when ready
+
+        If it fails, summary (and what done gets) is the exception.
+        """
+        def run():
+            lo, hi = self.overlap()
+
+            def work(s, e):
+                return _sums(self.samples[lo + s:lo + e], self.reference(lo + s, lo + e))
+
+            try:
+                parts = map_chunks(work, max(hi - lo, 0), chunk)
+                total = np.sum(parts, axis=0) if parts else np.zeros(8)
+                if parts:
+                    total[7] = max(p[7] for p in parts)  # peak is a max, not a sum
+                self.summary = _score(total)
+            except Exception as e:
+                self.summary = e
+            if done is not None:
+                done(self.summary)
+
+        thread = Thread(target=run, daemon=True)
+        thread.start()
+        return thread
+
+
+def align(slot, samples, done):
+    """Build a Compare (the whole-capture correlation) on a background thread
+
+    done(compare), or done(exception) if the alignment failed, is called from
+    that thread.
+    """
+    def run():
+        try:
+            result = Compare(slot, samples)
+        except Exception as e:
+            result = e
+        done(result)
+
+    thread = Thread(target=run, daemon=True)
+    thread.start()
+    return thread
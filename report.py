@@ -0,0 +1,170 @@
+# -*- coding: utf-8 -*-
+"""
+Headless batch reports: one HTML page per capture plus an index.
+
+Each capture gets a waveform overview (min/max pyramid), an eye when a bit
+period is found, a spectrum with its peaks, and a table of measurements.
+Figures are drawn on matplotlib's Agg canvas without pyplot or a display,
+to PNG or SVG, and captures are rendered in parallel worker processes
+(the rasterizer holds the GIL, so threads would not help).
+"""
+
+import argparse
+import html
+import pathlib
+import sys
+from concurrent.futures import ProcessPoolExecutor
+
+import numpy as np
+from matplotlib.backends.backend_agg import FigureCanvasAgg
+from matplotlib.figure import Figure
+
+import autoset
+import capture
+import counter
+import eye
+import peaks
+import pyramid
+from workers import WORKERS
+
+PATTERNS = ('*.txt', '*' + capture.SUFFIX)
+SIZE = (8, 3)
+POINTS = 2048
+
+
+def _save(fig, path):
+    FigureCanvasAgg(fig)
+    fig.savefig(path, dpi=100, bbox_inches='tight')
+    return path.name
+
+
+def overview(samples, rate, found, path):
+    fig = Figure(figsize=SIZE)
+    ax = fig.add_subplot()
+    x, lo, hi = pyramid.Pyramid.build(samples).view(samples, 0, len(samples), POINTS)
+    ax.fill_between(x / rate, lo, hi, step='post', linewidth=0.5)
+    ax.axhline(found['threshold'], color='red', linestyle='--', linewidth=0.8)
+    ax.set_xlabel("Seconds")
+    ax.set_title("Overview")
+    return _save(fig, path)
+
+
+def eye_diagram(samples, found, path):
+    bit = found['bit']
+    first = np.asarray(samples[:1 << 20], np.float64)
+    lo, hi = found['ylim']
+    folded = eye.Eye(bit, eye.best_phase(first, bit, found['threshold']), (lo, hi))
+    for a in range(0, len(samples), 1 << 20):
+        folded.add(samples[a:a + (1 << 20)], a)
+    values = eye.sample(first, eye.symbol_times(bit, folded.phase, 0, len(first))[1])
+    q, ber = eye.q_factor(values, found['threshold'])
+    fig = Figure(figsize=SIZE)
+    ax = fig.add_subplot()
+    ax.imshow(np.log1p(folded.hist.T), origin='lower', aspect='auto', cmap='inferno',
+              extent=(0, folded.ui, lo, hi))
+    ax.set_xlabel("UI")
+    ax.set_title("Eye, Q %.2f" % q)
+    return _save(fig, path), q, ber
+
+
+def spectrum(samples, rate, path):
+    avg = peaks.Averager(rate)
+    for a in range(0, len(samples), 1 << 20):
+        avg.feed(samples[a:a + (1 << 20)])
+    freq, db, found = peaks.search(avg)
+    fig = Figure(figsize=SIZE)
+    ax = fig.add_subplot()
+    ax.plot(freq, db, linewidth=0.6)
+    ax.plot(found['frequency'], found['level_db'], 'v', markersize=4)
+    ax.set_xlabel("Hz")
+    ax.set_ylabel("dB")
+    ax.set_title("Spectrum")
+    return _save(fig, path), found
+
+
+def _table(rows):
+    cells = "".join("<tr><th>%s</th><td>%s</td></tr>" % (html.escape(k), html.escape(str(v))) for k, v in rows)
+    return "<table>%s</table>" % cells
+
+
+def render(path, out, rate, dtype='uint16', fmt='png'):
+    """Figures and HTML page for one capture; returns (name, page, measurements)"""
+    path = pathlib.Path(path)
+    out = pathlib.Path(out)
+    stem = path.stem
+    samples = capture.load(str(path), dtype)
+    header = capture.read_header(str(path))
+    rate = header[1] if header and header[1] else rate
+    found = autoset.autoset(samples, rate)
+    m = [("Samples", len(samples)), ("Rate", "%g" % rate), ("Threshold", "%.1f" % found['threshold']),
+         ("Low / high", "%.1f / %.1f" % (found['low'], found['high']))]
+    images = [overview(samples, rate, found, out / ("%s_overview.%s" % (stem, fmt)))]
+    if found['baud']:
+        m.append(("Baud", "%.0f" % found['baud']))
+    if found['bit']:
+        name, q, ber = eye_diagram(samples, found, out / ("%s_eye.%s" % (stem, fmt)))
+        images.append(name)
+        m += [("Eye Q", "%.2f" % q), ("BER estimate", "%.2g" % ber)]
+    c = counter.measure(samples, found['threshold'], rate)
+    if c is not None:
+        m += [("Frequency", "%.8g Hz" % c['frequency']), ("Edge jitter", "%.3g s" % c['jitter'])]
+    name, found_peaks = spectrum(samples, rate, out / ("%s_spectrum.%s" % (stem, fmt)))
+    images.append(name)
+    spurs = found_peaks[found_peaks['harmonic'] == 0]
+    if len(spurs):
+        m.append(("Worst spur", "%.1f dBc at %.6g Hz" % (spurs['dbc'][0], spurs['frequency'][0])))
+    body = "".join('<img src="%s">' % html.escape(i) for i in images)
+    rows = "".join("<tr><td>%.6g</td><td>%.2f</td><td>%.2f</td><td>%s</td></tr>"
+                   % (r['frequency'], r['level_db'], r['dbc'], r['harmonic'] or 'spur') for r in found_peaks[:20])
+    page = out / (stem + ".html")
+    page.write_text("<html><head><title>%s</title></head><body><h1>%s</h1>%s%s"
+                    "<h2>Peaks</h2><table><tr><th>Hz</th><th>dB</th><th>dBc</th><th>kind</th></tr>%s</table>"
+                    "</body></html>" % (html.escape(stem), html.escape(path.name), _table(m), body, rows))
+    return path.name, page.name, m
+
+
+def batch(paths, out, rate, dtype='uint16', fmt='png', workers=WORKERS):
+    """Render every capture in parallel processes and write index.html"""
+    out = pathlib.Path(out)
+    out.mkdir(parents=True, exist_ok=True)
+    results = []
+    with ProcessPoolExecutor(max_workers=workers) as pool:
+        futures = [pool.submit(render, str(p), str(out), rate, dtype, fmt) for p in paths]
+        for p, f in zip(paths, futures):
+            try:
+                results.append(f.result())
+            except Exception as e:  # one bad capture should not sink the batch
+                results.append((pathlib.Path(p).name, None, [("Error", e)]))
+    keys = []
+    for _, _, m in results:
+        keys += [k for k, _ in m if k not in keys]
+    head = "".join("<th>%s</th>" % html.escape(k) for k in ["Capture"] + keys)
+    rows = []
+    for name, page, m in results:
+        values = dict(m)
+        link = '<a href="%s">%s</a>' % (html.escape(page), html.escape(name)) if page else html.escape(name)
+        rows.append("<tr><td>%s</td>%s</tr>" % (link, "".join(
+            "<td>%s</td>" % html.escape(str(values.get(k, ""))) for k in keys)))
+    (out / "index.html").write_text("<html><head><title>Report</title></head><body><h1>%d captures</h1>"
+                                    "<table><tr>%s</tr>%s</table></body></html>" % (len(results), head, "".join(rows)))
+    return results
+
+
+def main(argv=None):
+    p = argparse.ArgumentParser(description="Render HTML reports for a directory of captures")
+    p.add_argument('directory')
+    p.add_argument('out')
+    p.add_argument('--rate', type=float, default=1e6, help="sample rate of text captures")
+    p.add_argument('--dtype', default='uint16', choices=capture.DTYPES)
+    p.add_argument('--format', default='png', choices=('png', 'svg'))
+    p.add_argument('--workers', type=int, default=WORKERS)
+    args = p.parse_args(argv)
+
+    paths = sorted({q for pattern in PATTERNS for q in pathlib.Path(args.directory).glob(pattern)})
+    results = batch(paths, args.out, args.rate, args.dtype, args.format, args.workers)
+    failed = sum(page is None for _, page, _ in results)
+    print("%d reports, %d failed" % (len(results) - failed, failed), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
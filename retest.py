@@ -25,6 +25,34 @@ import matplotlib.patches as mpatches
 import sys
 import binascii
 from untitled0 import *
+import iq
+import decoders
+import hooks
+import capture
+import events
+import timeline
+import acquire
+import recorder
+import flight
+import triggers
+import autoset
+import counter
+import transfer
+import delay
+import analytic
+import baseline
+import adc
+import peaks
+import eye
+import equalize
+import tracking
+import bathtub
+import pyramid
+import reference
+import archive
+import arrowio
+import hdf5io
+import memory
 import ttkbootstrap as ttk
 from ttkbootstrap.constants import *
 from ttkbootstrap import utility
@@ -32,6 +60,11 @@ from tkinter.filedialog import askdirectory
 from tkinter import filedialog
 
 
+LIVE_POINTS = 4096
+MAKE_BYTES = 64  # per sample in Make: float copy, logic, bit list and string, plot index
+TRIGGERS = ('off', 'edge', 'pattern', 'uart bytes', 'decoder error')
+
+
 class FileSearchEngine(ttk.Frame):
 
     queue = Queue()
@@ -47,6 +80,48 @@ class FileSearchEngine(ttk.Frame):
         self.term_var = ttk.StringVar(value='md')
         self.type_var = ttk.StringVar(value='endswidth')
         self.cast_var = ttk.StringVar(value='uint16')
+        self.thresh_var = ttk.IntVar(value=1000)
+        self.derived_var = ttk.StringVar(value='raw')
+        self.baseline_var = ttk.IntVar(value=0)
+        self.mod_var = ttk.StringVar(value='QPSK')
+        self.sps_var = ttk.IntVar(value=8)
+        self.stack_var = ttk.StringVar(value='slicer:threshold=1000 | uart:bit=16')
+        self.hook_var = ttk.StringVar(value='')
+        self.etype_var = ttk.StringVar(value='all')
+        self.errors_var = ttk.BooleanVar(value=False)
+        self.events = events.EventStore()
+        self.rate_var = ttk.DoubleVar(value=1e6)
+        self.view_var = ttk.DoubleVar(value=0.0)
+        self.span_var = ttk.DoubleVar(value=0.01)
+        self.timeline = None
+        self.live_var = ttk.StringVar(value='Stopped')
+        self.ring = self.acq = self.recorder = self.live_line = None
+        self.pre_var = ttk.DoubleVar(value=5.0)
+        self.post_var = ttk.DoubleVar(value=1.0)
+        self.level_var = ttk.IntVar(value=1000)
+        self.trig_var = ttk.StringVar(value='off')
+        self.match_var = ttk.StringVar(value='')
+        self.flight = self.trigger = None
+        self.dumps = 0
+        self.nominal_var = ttk.DoubleVar(value=0.0)
+        self.gate_var = ttk.DoubleVar(value=0.0)
+        self.chb_var = ttk.StringVar(value='')
+        self.deskew_var = ttk.BooleanVar(value=True)
+        self.spectrum = self.spectrum_pos = self.spectrum_line = None
+        self.bit_var = ttk.DoubleVar(value=16.0)
+        self.zero_var = ttk.DoubleVar(value=0.0)
+        self.pole_var = ttk.DoubleVar(value=0.0)
+        self.ffe_var = ttk.IntVar(value=7)
+        self.dfe_var = ttk.IntVar(value=2)
+        self.eq_var = ttk.BooleanVar(value=False)
+        self.adaptive_var = ttk.BooleanVar(value=False)
+        self.slot_var = ttk.IntVar(value=1)
+        self.refdisk_var = ttk.BooleanVar(value=False)
+        self.ref_var = ttk.StringVar(value='')
+        self.mem_var = ttk.StringVar(value='')
+        self.archive = archive.Archive(pathlib.Path(__file__).parent / 'archive')
+        self.refs = reference.Slots(pathlib.Path(__file__).parent / 'references')
+        self.plugins = decoders.load_plugins(pathlib.Path(__file__).parent / 'plugins')
 
 
         # header and labelframe option container
@@ -56,6 +131,18 @@ class FileSearchEngine(ttk.Frame):
 
         self.create_path_row()
         self.create_go_row()
+        self.create_iq_row()
+        self.create_decode_row()
+        self.create_hook_row()
+        self.create_events_row()
+        self.create_timeline_row()
+        self.create_live_row()
+        self.create_history_row()
+        self.create_measure_row()
+        self.create_channels_row()
+        self.create_equalizer_row()
+        self.create_reference_row()
+        self.create_memory_row()
         self.progressbar = ttk.Progressbar(
             master=self, 
             mode=INDETERMINATE, 
@@ -94,9 +181,302 @@ class FileSearchEngine(ttk.Frame):
             width=8
         )
         make_btn.pack(side=LEFT, padx=5)
+        auto_btn = ttk.Button(
+            master=path_row,
+            text="Autoset",
+            command=self.on_autoset,
+            width=8
+        )
+        auto_btn.pack(side=LEFT, padx=5)
+        thresh_lbl = ttk.Label(path_row, text="Threshold")
+        thresh_lbl.pack(side=LEFT, padx=(15, 0))
+        thresh_ent = ttk.Entry(path_row, textvariable=self.thresh_var, width=8)
+        thresh_ent.pack(side=LEFT, padx=5)
+        adaptive_chk = ttk.Checkbutton(path_row, text="Adaptive", variable=self.adaptive_var)
+        adaptive_chk.pack(side=LEFT, padx=5)
+        derived_op = ttk.OptionMenu(path_row, self.derived_var, 'raw', 'raw', *analytic.KINDS)
+        derived_op.pack(side=LEFT, padx=5)
+        base_lbl = ttk.Label(path_row, text="Baseline")
+        base_lbl.pack(side=LEFT, padx=(15, 0))
+        base_ent = ttk.Entry(path_row, textvariable=self.baseline_var, width=8)
+        base_ent.pack(side=LEFT, padx=5)
         option_list = ['Pick a data type', 'uint16', 'int16', 'uint32']
         op = ttk.OptionMenu(self, self.cast_var, *option_list)
         op.pack(side=RIGHT, padx=(15, 0))
+
+    def create_iq_row(self):
+        """Add IQ constellation row to labelframe"""
+        iq_row = ttk.Frame(self.option_lf)
+        iq_row.pack(fill=X, expand=YES, pady=(15, 0))
+        iq_lbl = ttk.Label(iq_row, text="IQ", width=8)
+        iq_lbl.pack(side=LEFT, padx=(15, 0))
+        mod_op = ttk.OptionMenu(iq_row, self.mod_var, self.mod_var.get(), *iq.CONSTELLATIONS)
+        mod_op.pack(side=LEFT, padx=5)
+        sps_lbl = ttk.Label(iq_row, text="Samples/symbol")
+        sps_lbl.pack(side=LEFT, padx=(15, 0))
+        sps_ent = ttk.Entry(iq_row, textvariable=self.sps_var, width=6)
+        sps_ent.pack(side=LEFT, padx=5)
+        iq_btn = ttk.Button(
+            master=iq_row,
+            text="Constellation",
+            command=self.Constellation
+        )
+        iq_btn.pack(side=LEFT, padx=5)
+
+    def create_decode_row(self):
+        """Add decoder stack row to labelframe"""
+        dec_row = ttk.Frame(self.option_lf)
+        dec_row.pack(fill=X, expand=YES, pady=(15, 0))
+        dec_lbl = ttk.Label(dec_row, text="Decode", width=8)
+        dec_lbl.pack(side=LEFT, padx=(15, 0))
+        dec_ent = ttk.Entry(dec_row, textvariable=self.stack_var)
+        dec_ent.pack(side=LEFT, fill=X, expand=YES, padx=5)
+        dec_btn = ttk.Button(
+            master=dec_row,
+            text="Decode",
+            command=self.Decode,
+            width=8
+        )
+        dec_btn.pack(side=LEFT, padx=5)
+
+    def create_hook_row(self):
+        """Add analysis hook script row to labelframe"""
+        hook_row = ttk.Frame(self.option_lf)
+        hook_row.pack(fill=X, expand=YES, pady=(15, 0))
+        hook_lbl = ttk.Label(hook_row, text="Hook", width=8)
+        hook_lbl.pack(side=LEFT, padx=(15, 0))
+        hook_ent = ttk.Entry(hook_row, textvariable=self.hook_var)
+        hook_ent.pack(side=LEFT, fill=X, expand=YES, padx=5)
+        hook_btn = ttk.Button(
+            master=hook_row,
+            text="Browse",
+            command=self.on_browse_hook,
+            width=8
+        )
+        hook_btn.pack(side=LEFT, padx=5)
+
+    def create_events_row(self):
+        """Add decoded event query row to labelframe"""
+        ev_row = ttk.Frame(self.option_lf)
+        ev_row.pack(fill=X, expand=YES, pady=(15, 0))
+        ev_lbl = ttk.Label(ev_row, text="Events", width=8)
+        ev_lbl.pack(side=LEFT, padx=(15, 0))
+        type_op = ttk.OptionMenu(ev_row, self.etype_var, 'all', 'all', *decoders.KINDS.values())
+        type_op.pack(side=LEFT, padx=5)
+        err_chk = ttk.Checkbutton(ev_row, text="Errors only", variable=self.errors_var)
+        err_chk.pack(side=LEFT, padx=5)
+        table_btn = ttk.Button(
+            master=ev_row,
+            text="Table",
+            command=self.on_table,
+            width=8
+        )
+        table_btn.pack(side=LEFT, padx=5)
+        export_btn = ttk.Button(
+            master=ev_row,
+            text="Export",
+            command=self.on_export,
+            width=8
+        )
+        export_btn.pack(side=LEFT, padx=5)
+        arrow_btn = ttk.Button(
+            master=ev_row,
+            text="Arrow",
+            command=self.on_export_arrow,
+            width=8
+        )
+        arrow_btn.pack(side=LEFT, padx=5)
+        h5_btn = ttk.Button(
+            master=ev_row,
+            text="HDF5",
+            command=self.on_export_hdf5,
+            width=8
+        )
+        h5_btn.pack(side=LEFT, padx=5)
+        archive_btn = ttk.Button(
+            master=ev_row,
+            text="Archive",
+            command=self.on_archive,
+            width=8
+        )
+        archive_btn.pack(side=LEFT, padx=5)
+
+    def create_timeline_row(self):
+        """Add multi-capture timeline row to labelframe"""
+        tl_row = ttk.Frame(self.option_lf)
+        tl_row.pack(fill=X, expand=YES, pady=(15, 0))
+        tl_lbl = ttk.Label(tl_row, text="Timeline", width=8)
+        tl_lbl.pack(side=LEFT, padx=(15, 0))
+        for text, var in (("Rate", self.rate_var), ("Start (s)", self.view_var), ("Span (s)", self.span_var)):
+            ttk.Label(tl_row, text=text).pack(side=LEFT, padx=(5, 0))
+            ttk.Entry(tl_row, textvariable=var, width=10).pack(side=LEFT, padx=5)
+        open_btn = ttk.Button(
+            master=tl_row,
+            text="Open dir",
+            command=self.on_timeline,
+            width=8
+        )
+        open_btn.pack(side=LEFT, padx=5)
+        view_btn = ttk.Button(
+            master=tl_row,
+            text="View",
+            command=self.on_timeline_view,
+            width=8
+        )
+        view_btn.pack(side=LEFT, padx=5)
+
+    def create_live_row(self):
+        """Add live acquisition and recording row to labelframe"""
+        live_row = ttk.Frame(self.option_lf)
+        live_row.pack(fill=X, expand=YES, pady=(15, 0))
+        live_lbl = ttk.Label(live_row, text="Live", width=8)
+        live_lbl.pack(side=LEFT, padx=(15, 0))
+        for text, command in (("Start", self.on_live_start), ("Stop", self.on_live_stop),
+                              ("Record", self.on_record)):
+            btn = ttk.Button(master=live_row, text=text, command=command, width=8)
+            btn.pack(side=LEFT, padx=5)
+        status_lbl = ttk.Label(live_row, textvariable=self.live_var)
+        status_lbl.pack(side=LEFT, padx=5)
+
+    def create_history_row(self):
+        """Add flight recorder (pre-trigger history) row to labelframe"""
+        hist_row = ttk.Frame(self.option_lf)
+        hist_row.pack(fill=X, expand=YES, pady=(15, 0))
+        hist_lbl = ttk.Label(hist_row, text="History", width=8)
+        hist_lbl.pack(side=LEFT, padx=(15, 0))
+        for text, var in (("Pre (s)", self.pre_var), ("Post (s)", self.post_var), ("Level", self.level_var)):
+            ttk.Label(hist_row, text=text).pack(side=LEFT, padx=(5, 0))
+            ttk.Entry(hist_row, textvariable=var, width=8).pack(side=LEFT, padx=5)
+        trig_op = ttk.OptionMenu(hist_row, self.trig_var, 'off', *TRIGGERS)
+        trig_op.pack(side=LEFT, padx=5)
+        match_ent = ttk.Entry(hist_row, textvariable=self.match_var, width=16)
+        match_ent.pack(side=LEFT, padx=5)
+        mark_btn = ttk.Button(
+            master=hist_row,
+            text="Mark",
+            command=self.on_mark,
+            width=8
+        )
+        mark_btn.pack(side=LEFT, padx=5)
+
+    def create_measure_row(self):
+        """Add measurement row to labelframe"""
+        meas_row = ttk.Frame(self.option_lf)
+        meas_row.pack(fill=X, expand=YES, pady=(15, 0))
+        meas_lbl = ttk.Label(meas_row, text="Measure", width=8)
+        meas_lbl.pack(side=LEFT, padx=(15, 0))
+        for text, var in (("Nominal Hz", self.nominal_var), ("Gate (s)", self.gate_var)):
+            ttk.Label(meas_row, text=text).pack(side=LEFT, padx=(5, 0))
+            ttk.Entry(meas_row, textvariable=var, width=10).pack(side=LEFT, padx=5)
+        count_btn = ttk.Button(
+            master=meas_row,
+            text="Counter",
+            command=self.on_counter,
+            width=8
+        )
+        count_btn.pack(side=LEFT, padx=5)
+        adc_btn = ttk.Button(
+            master=meas_row,
+            text="ADC",
+            command=self.on_adc,
+            width=8
+        )
+        adc_btn.pack(side=LEFT, padx=5)
+        peaks_btn = ttk.Button(
+            master=meas_row,
+            text="Peaks",
+            command=self.on_peaks,
+            width=8
+        )
+        peaks_btn.pack(side=LEFT, padx=5)
+
+    def create_channels_row(self):
+        """Add two-channel analysis row to labelframe"""
+        ch_row = ttk.Frame(self.option_lf)
+        ch_row.pack(fill=X, expand=YES, pady=(15, 0))
+        ch_lbl = ttk.Label(ch_row, text="Ch B", width=8)
+        ch_lbl.pack(side=LEFT, padx=(15, 0))
+        ch_ent = ttk.Entry(ch_row, textvariable=self.chb_var)
+        ch_ent.pack(side=LEFT, fill=X, expand=YES, padx=5)
+        for text, command in (("Browse", self.on_browse_chb), ("Bode", self.on_bode), ("Delay", self.on_delay)):
+            btn = ttk.Button(master=ch_row, text=text, command=command, width=8)
+            btn.pack(side=LEFT, padx=5)
+        deskew_chk = ttk.Checkbutton(ch_row, text="Deskew", variable=self.deskew_var)
+        deskew_chk.pack(side=LEFT, padx=5)
+
+    def create_equalizer_row(self):
+        """Add receiver equalizer (CTLE/FFE/DFE) row to labelframe"""
+        eq_row = ttk.Frame(self.option_lf)
+        eq_row.pack(fill=X, expand=YES, pady=(15, 0))
+        eq_lbl = ttk.Label(eq_row, text="Equalize", width=8)
+        eq_lbl.pack(side=LEFT, padx=(15, 0))
+        for text, var in (("Bit", self.bit_var), ("Zero Hz", self.zero_var), ("Pole Hz", self.pole_var),
+                          ("FFE", self.ffe_var), ("DFE", self.dfe_var)):
+            ttk.Label(eq_row, text=text).pack(side=LEFT, padx=(5, 0))
+            ttk.Entry(eq_row, textvariable=var, width=8).pack(side=LEFT, padx=5)
+        eq_chk = ttk.Checkbutton(eq_row, text="In Make", variable=self.eq_var)
+        eq_chk.pack(side=LEFT, padx=5)
+        cmp_btn = ttk.Button(
+            master=eq_row,
+            text="Compare",
+            command=self.on_equalize,
+            width=8
+        )
+        cmp_btn.pack(side=LEFT, padx=5)
+        tub_btn = ttk.Button(
+            master=eq_row,
+            text="Bathtub",
+            command=self.on_bathtub,
+            width=8
+        )
+        tub_btn.pack(side=LEFT, padx=5)
+
+    def create_reference_row(self):
+        """Add reference waveform slot row to labelframe"""
+        ref_row = ttk.Frame(self.option_lf)
+        ref_row.pack(fill=X, expand=YES, pady=(15, 0))
+        ref_lbl = ttk.Label(ref_row, text="Reference", width=8)
+        ref_lbl.pack(side=LEFT, padx=(15, 0))
+        slots = list(range(1, reference.SLOTS + 1))
+        slot_op = ttk.OptionMenu(ref_row, self.slot_var, slots[0], *slots)
+        slot_op.pack(side=LEFT, padx=5)
+        disk_chk = ttk.Checkbutton(ref_row, text="On disk", variable=self.refdisk_var)
+        disk_chk.pack(side=LEFT, padx=5)
+        for text, command in (("Store", self.on_ref_store), ("Overlay", self.on_ref_overlay)):
+            btn = ttk.Button(master=ref_row, text=text, command=command, width=8)
+            btn.pack(side=LEFT, padx=5)
+        ref_status = ttk.Label(ref_row, textvariable=self.ref_var)
+        ref_status.pack(side=LEFT, padx=5)
+
+    def create_memory_row(self):
+        """Add memory governor status row to labelframe"""
+        mem_row = ttk.Frame(self.option_lf)
+        mem_row.pack(fill=X, expand=YES, pady=(15, 0))
+        mem_lbl = ttk.Label(mem_row, text="Memory", width=8)
+        mem_lbl.pack(side=LEFT, padx=(15, 0))
+        free_btn = ttk.Button(
+            master=mem_row,
+            text="Free",
+            command=self.on_free,
+            width=8
+        )
+        free_btn.pack(side=LEFT, padx=5)
+        mem_status = ttk.Label(mem_row, textvariable=self.mem_var)
+        mem_status.pack(side=LEFT, padx=5)
+        self.memory_tick()
+
+    def memory_tick(self):
+        """Refresh the memory governor status once a second"""
+        u = memory.GOVERNOR.usage()
+        self.mem_var.set("%.1f of %.0f MB, %d cached, %d spilled, %d evicted, %.0f%% hits"
+                         % (u['used'] / 1e6, u['budget'] / 1e6, u['entries'], u['spilled'],
+                            u['evictions'], 100 * u['hit_rate']))
+        self.after(1000, self.memory_tick)
+
+    def on_free(self):
+        """Drop every cached capture, pyramid and decode result"""
+        memory.GOVERNOR.clear()
+
     def create_term_row(self):
         """Add term row to labelframe"""
         term_row = ttk.Frame(self.option_lf)
@@ -120,25 +500,671 @@ class FileSearchEngine(ttk.Frame):
         if path:
             self.path_var.set(path)
 
+    def on_browse_chb(self):
+        """Callback for second channel browse"""
+        path = filedialog.askopenfilename(title="Channel B")
+        if path:
+            self.chb_var.set(path)
+
+    def on_browse_hook(self):
+        """Callback for hook script browse"""
+        path = filedialog.askopenfilename(title="Hook script", filetypes=[("Python", "*.py")])
+        if path:
+            self.hook_var.set(path)
+
+    def capture_key(self):
+        """Governor key of the selected capture, new whenever the file changes"""
+        path = self.path_var.get()
+        return 'capture', path, pathlib.Path(path).stat().st_mtime, self.cast_var.get()
+
+    def Load(self):
+        """Read the selected capture into a sample buffer, cached by the memory governor"""
+        path, cast = self.path_var.get(), self.cast_var.get()
+        return memory.GOVERNOR.cached(self.capture_key(), lambda: capture.load(path, cast))
+
+    def Source(self):
+        """Selected capture as the raw or a derived (Hilbert) channel"""
+        rx_data1 = self.Load()
+        if self.derived_var.get() == 'raw':
+            return rx_data1
+        return analytic.DerivedChannel(rx_data1, self.derived_var.get(), self.rate_var.get())
+
+    def event_query(self):
+        """Query of the decoded events matching the Events row"""
+        q = self.events.query()
+        if self.etype_var.get() != 'all':
+            q = q.type(self.etype_var.get())
+        if self.errors_var.get():
+            q = q.errors()
+        return q
+
+    def on_table(self):
+        """Show the selected events in a table window"""
+        q = self.event_query()
+        rows = q.rows(limit=10000)  # the Treeview slows down past this
+        top = ttk.Toplevel(title="Events (%d of %d)" % (len(rows), q.count()))
+        tree = ttk.Treeview(top, columns=events.COLUMNS, show='headings')
+        for c in events.COLUMNS:
+            tree.heading(c, text=c)
+        for r, name in zip(rows, q.type_names(rows['type'])):
+            tree.insert('', END, values=(r['time'], r['duration'], name, "%X" % r['value'], r['flags']))
+        tree.pack(fill=BOTH, expand=YES)
+
+    def on_live_start(self):
+        """Start live acquisition (replaying the selected capture in real time)"""
+        if self.acq is not None:
+            return
+        rate = self.rate_var.get()
+        samples = self.Load()
+        pre, post = self.pre_var.get(), self.post_var.get()
+        # at least two seconds, enough to ride out a slow disk while recording;
+        # deeper history stays in RAM up to the flight recorder's budget
+        depth = int((pre + post) * rate)
+        if depth * samples.dtype.itemsize > flight.RAM_BYTES:
+            depth = 0
+        self.ring = acquire.RingBuffer(max(1 << 20, int(2 * rate), depth), samples.dtype)
+        self.acq = acquire.Acquisition(acquire.ReplaySource(samples, rate), self.ring, rate).start()
+        events_dir = pathlib.Path(self.path_var.get()).parent / 'events'
+        self.flight = flight.FlightRecorder(self.ring, self.acq, pre, post, events_dir)
+        trig = self.make_trigger()
+        if trig is not None:
+            self.trigger = triggers.TriggerThread(self.ring, [trig], self.flight.mark, int((pre + post) * rate))
+        fig, ax = plt.subplots()
+        self.live_line, = ax.plot([], [])
+        plt.show(block=False)
+        self.after(50, self.live_tick)
+
+    def live_tick(self):
+        """Refresh the live plot and recorder status"""
+        if self.acq is None:
+            return
+        data = self.ring.latest(LIVE_POINTS)
+        self.live_line.set_data(np.arange(len(data)), data)
+        ax = self.live_line.axes
+        ax.relim()
+        ax.autoscale_view()
+        ax.figure.canvas.draw_idle()
+        status = "%d samples" % self.ring.head
+        if self.recorder is not None:
+            st = self.recorder.stats()
+            status += ", recording %d (%d overruns, %d lost)" % (st['written'], st['overruns'], st['lost'])
+        while not self.flight.written.empty():
+            self.flight.written.get()
+            self.dumps += 1
+        if self.dumps:
+            status += ", %d events saved" % self.dumps
+        if self.spectrum is not None:
+            self.spectrum_tick()
+        self.live_var.set(status)
+        self.after(50, self.live_tick)
+
+    def on_record(self):
+        """Toggle recording of the live stream to a binary capture"""
+        if self.recorder is not None:
+            self.stop_recording()
+            return
+        if self.acq is None:
+            return
+        path = filedialog.asksaveasfilename(title="Record to", defaultextension=capture.SUFFIX)
+        if path:
+            pos = self.ring.head
+            self.recorder = recorder.Recorder(self.ring, path, self.acq.rate, pos, self.acq.time_of(pos))
+
+    def stop_recording(self):
+        st = self.recorder.stop()
+        self.recorder = None
+        if st['overruns']:
+            messagebox.showwarning("Record", "%d samples lost in %d overruns" % (st['lost'], st['overruns']))
+
+    def on_live_stop(self):
+        """Stop recording and acquisition"""
+        if self.recorder is not None:
+            self.stop_recording()
+        if self.trigger is not None:
+            self.trigger.stop()
+            self.trigger = None
+        if self.flight is not None:
+            self.flight.close()
+            self.flight = None
+        if self.acq is not None:
+            self.acq.stop()
+            self.acq = None
+        self.spectrum = None
+        self.live_var.set('Stopped')
+
+    def make_trigger(self):
+        """Trigger selected in the History row, or None"""
+        kind = self.trig_var.get()
+        if kind == 'edge':
+            return triggers.EdgeTrigger(self.level_var.get())
+        spec = self.stack_var.get()
+        if kind == 'pattern':
+            # slice and time bits the way the decoder stack does
+            threshold, bit = self.thresh_var.get(), 1
+            stack = decoders.build(spec, self.plugins)
+            try:
+                for d in stack.decoders:
+                    threshold = getattr(d, 'threshold', threshold)
+                    bit = getattr(d, 'bit', bit)
+            finally:
+                stack.close()
+            return triggers.PatternTrigger(self.match_var.get(), threshold, bit)
+        if kind == 'uart bytes':
+            match = triggers.ByteSequence(triggers.parse_bytes(self.match_var.get()))
+            return triggers.StackTrigger(lambda: decoders.build(spec, self.plugins), match, 'uart')
+        if kind == 'decoder error':
+            return triggers.StackTrigger(lambda: decoders.build(spec, self.plugins),
+                                         triggers.decoder_errors, 'error')
+        return None
+
+    def on_mark(self):
+        """Save the history window around now"""
+        if self.flight is not None:
+            self.flight.mark(reason='manual')
+
+    def on_timeline(self):
+        """Index a directory of captures and plot their coverage"""
+        path = askdirectory(title="Capture directory")
+        if not path:
+            return
+        self.timeline = tl = timeline.Timeline.open(path, self.rate_var.get())
+        if not tl.segments:
+            messagebox.showinfo("Timeline", "No captures in %s" % path)
+            return
+        plt.figure()
+        for seg in tl.segments:
+            plt.axvspan(seg.start - tl.start, seg.end - tl.start, color='green', alpha=0.3)
+        for g0, g1 in tl.gaps():
+            plt.axvspan(g0 - tl.start, g1 - tl.start, color='red', alpha=0.3)
+        plt.title("%d captures from %s, %d gaps" % (
+            len(tl.segments), datetime.datetime.fromtimestamp(tl.start), len(tl.gaps())))
+        plt.xlabel("Seconds")
+        plt.show()
+
+    def on_timeline_view(self):
+        """Plot Start..Start+Span of the timeline, opening only overlapping captures"""
+        tl = self.timeline
+        if tl is None:
+            return
+        t0 = tl.start + self.view_var.get()
+        plt.figure()
+        for t, data in tl.window(t0, t0 + self.span_var.get(), self.cast_var.get()):
+            plt.plot(t - tl.start, data)
+        for g0, g1 in tl.gaps():
+            plt.axvspan(g0 - tl.start, g1 - tl.start, color='red', alpha=0.3)
+        plt.xlim(self.view_var.get(), self.view_var.get() + self.span_var.get())
+        plt.xlabel("Seconds")
+        plt.show()
+
+    def on_export(self):
+        """Export the selected events to CSV"""
+        path = filedialog.asksaveasfilename(title="Export events", defaultextension=".csv")
+        if path:
+            self.event_query().to_csv(path)
+
+    def on_export_arrow(self):
+        """Export samples, edges and decoded events as Arrow IPC or Parquet"""
+        path = filedialog.asksaveasfilename(title="Export tables", defaultextension=".arrow",
+                                            filetypes=[("Arrow IPC", "*.arrow"), ("Parquet", "*.parquet")])
+        if not path:
+            return
+        suffix = '.parquet' if path.endswith('.parquet') else '.arrow'
+        try:
+            written = arrowio.export(path, self.Load(), self.rate_var.get(), store=self.events, suffix=suffix)
+        except RuntimeError as e:
+            messagebox.showerror("Export", str(e))
+            return
+        messagebox.showinfo("Export", "\n".join(p.name for p in written))
+
+    def on_export_hdf5(self):
+        """Save the capture as a chunked, compressed HDF5 dataset"""
+        path = filedialog.asksaveasfilename(title="Save HDF5", defaultextension=".h5",
+                                            filetypes=[("HDF5", "*.h5 *.hdf5")])
+        if not path:
+            return
+        try:
+            hdf5io.save(path, self.Load(), self.rate_var.get())
+        except RuntimeError as e:
+            messagebox.showerror("HDF5", str(e))
+
+    def on_archive(self):
+        """Add the capture to the deduplicating archive"""
+        name = pathlib.Path(self.path_var.get()).stem
+        path, stats = self.archive.put(name, self.Load(), self.rate_var.get())
+        messagebox.showinfo("Archive", "%s\n%d chunks, %d unique, %d new\n%d bytes stored for %d"
+                            % (path.name, stats['chunks'], stats['unique'], stats['new'],
+                               stats['stored'], stats['bytes']))
+
     def Make(self):
         a = ""
         teststring = []
 
         # file loader
-        rx_data1 = np.loadtxt(self.path_var.get(), dtype=self.cast_var.get(), delimiter='\n',
-                              converters={_: lambda s: np.short(int(s, 16)) for _ in range(1)}, encoding="utf8")
+        rx_data1 = np.asarray(self.Source())
+        need = len(rx_data1) * MAKE_BYTES
+        # caches give way first; past the budget the user decides
+        if not memory.GOVERNOR.reserve(need) and not messagebox.askokcancel(
+                "Make", "Plotting needs about %d MB, over the %d MB memory budget. Plot anyway?"
+                % (need >> 20, memory.GOVERNOR.budget >> 20)):
+            return
+        threshold = self.thresh_var.get()
+        if self.baseline_var.get() > 0:  # window in samples, 0 for a fixed baseline
+            rx_data1 = baseline.restore(rx_data1, self.baseline_var.get(), threshold)
+        if self.eq_var.get():
+            rx_data1 = equalize.equalize(rx_data1, self.make_equalizer())
 
-        for y in rx_data1:  # separates the bits into highs and lows
-            if y < 1000:
-                a += "0"
-                teststring.append(0);
-            else:
-                a += "1"
-                teststring.append(1);
+        # separates the bits into highs and lows
+        if self.adaptive_var.get():  # threshold tracks the signal levels
+            logic, levels = tracking.slice_capture(rx_data1, threshold)
+        else:
+            logic, levels = (rx_data1 >= threshold).view(np.uint8), None
+        teststring = logic.tolist()
+        a = (logic + ord('0')).tobytes().decode()
 
         arr1 = list(range(0, len(rx_data1)))
         plt.figure()
         plt.plot(arr1, rx_data1)
+        if levels is not None:
+            plt.plot(arr1, levels, color='red', linestyle='--')
+        plt.show()
+
+    def on_autoset(self):
+        """Choose threshold, trigger level, scale and timebase from the capture"""
+        rx_data1 = self.Source()
+        rate = self.rate_var.get()
+        found = autoset.autoset(rx_data1, rate)
+        self.thresh_var.set(int(round(found['threshold'])))
+        self.level_var.set(int(round(found['trigger'])))
+        # retune the stages already in the stack; plugins, baseline and equalizer stay as they are
+        spec = self.stack_var.get()
+        stages = [p.partition(':')[0].strip() for p in spec.split('|')]
+        if 'baseline' not in stages:  # after a baseline the threshold is relative to its level
+            for name in ('slicer', 'tracker'):
+                spec = decoders.set_options(spec, name, threshold='%d' % round(found['threshold']))
+        if found['bit']:
+            spec = decoders.set_options(spec, 'uart', bit='%.3f' % found['bit'])
+        self.stack_var.set(spec)
+        span = found['span']
+        plt.figure()
+        plt.plot(np.arange(min(len(rx_data1), 4 * span)), rx_data1[:4 * span])
+        plt.axhline(found['threshold'], color='red', linestyle='--')
+        plt.xlim(0, span)
+        plt.ylim(*found['ylim'])
+        title = "Threshold %d" % found['threshold']
+        if found['baud']:
+            title += ", ~%d baud" % round(found['baud'])
+        elif found['period']:
+            title += ", %.4g Hz" % (rate / found['period'])
+        plt.title(title)
+        plt.show()
+
+    def make_equalizer(self):
+        """Equalizer from the Equalize row, slicing at the Make threshold"""
+        return equalize.Equalizer(self.bit_var.get(), self.thresh_var.get(), self.rate_var.get(),
+                                  self.zero_var.get(), self.pole_var.get(), self.ffe_var.get(), self.dfe_var.get())
+
+    def on_equalize(self):
+        """Eyes and estimated BER with and without equalization, side by side"""
+        eq = self.make_equalizer()
+        r = equalize.compare(self.Source(), eq)
+        fig, axes = plt.subplots(1, 2, sharey=True)
+        for ax, name in zip(axes, ('raw', 'equalized')):
+            e = r[name]['eye']
+            ax.imshow(np.log1p(e.hist.T), origin='lower', aspect='auto', cmap='inferno',
+                      extent=(e.times[0], e.times[-1], e.levels[0], e.levels[-1]))
+            ax.axhline(eq.threshold, color='white', linestyle='--', linewidth=0.5)
+            ax.set_title("%s: Q %.2f, BER ~%.2g, opening %.4g" % (name, r[name]['q'], r[name]['ber'],
+                                                                  r[name]['opening']))
+            ax.set_xlabel("UI")
+        fig.suptitle("FFE %s  DFE %s" % (np.round(eq.w, 3), np.round(eq.b, 3)))
+        plt.show()
+
+    def on_bathtub(self):
+        """Bathtubs and BER contours, extrapolated to 1e-12, from one labelled eye"""
+        samples = self.Source()
+        if self.eq_var.get():
+            samples = equalize.equalize(samples, self.make_equalizer())
+        sps, threshold = self.bit_var.get(), self.thresh_var.get()
+        first = np.asarray(samples[:1 << 20], np.float64)
+        lo, hi = np.percentile(first, (0.1, 99.9))
+        folded = eye.Eye(sps, eye.best_phase(first, sps, threshold),
+                         (lo - 0.25 * (hi - lo), hi + 0.25 * (hi - lo)), threshold=threshold)
+        for a in range(0, len(samples), 1 << 20):
+            folded.add(samples[a:a + (1 << 20)], a)
+        r = bathtub.analyze(folded)
+        q = np.linspace(0, 8, 50)
+        fig, (ax1, ax2, ax3) = plt.subplots(1, 3)
+        for ax, tub, pos, ber, label in (
+                (ax1, r['horizontal'], r['phases'], r['ber'][:, r['row']], "UI"),
+                (ax2, r['vertical'], r['levels'], r['ber'][r['col']], "Level")):
+            ax.semilogy(pos, ber, '.')
+            for fit in (tub['left'], tub['right']):
+                if fit is not None:
+                    ax.semilogy(bathtub.extrapolate(fit, q), bathtub.ber_of_q(q), '--')
+            ax.set_ylim(1e-13, 1)
+            ax.set_xlabel(label)
+            if tub['opening'] is None:
+                ax.set_title("no fit")
+            else:
+                ax.set_title("opening %s%.4g at 1e-12" % (">= " if tub['fit'] == 'bounded' else "", tub['opening']))
+        ax1.set_ylabel("BER")
+        ax3.imshow(np.log1p(r['density'].T), origin='lower', aspect='auto', cmap='gray',
+                   extent=(r['phases'][0], r['phases'][-1], folded.levels[0], folded.levels[-1]))
+        for i, level in enumerate(r['contours']):
+            edges = r['contour_edges'][:, i]
+            ax3.plot(edges[:, 0], r['levels'], color='C%d' % i, label="%g" % level)
+            ax3.plot(edges[:, 1], r['levels'], color='C%d' % i)
+        ax3.set_xlabel("UI")
+        ax3.legend()
+        plt.show()
+
+    def on_ref_store(self):
+        """Store the current capture in the selected reference slot"""
+        slot = self.refs.store(self.slot_var.get(), self.Source(), self.rate_var.get(), self.refdisk_var.get())
+        self.ref_var.set("Slot %d: %d samples%s" % (self.slot_var.get(), len(slot.samples),
+                                                     " on disk" if slot.path else ""))
+
+    def on_ref_overlay(self):
+        """Overlay the aligned reference on Start..Start+Span, with the difference channel"""
+        slot = self.refs.get(self.slot_var.get())
+        if slot is None:
+            messagebox.showinfo("Reference", "Slot %d is empty" % self.slot_var.get())
+            return
+        rate = self.rate_var.get()
+        start = int(self.view_var.get() * rate)
+        span = max(int(self.span_var.get() * rate), 1)
+        # the whole-capture correlation runs off the UI thread
+        self.ref_var.set("Aligning...")
+        pending = []
+        reference.align(slot, self.Source(), pending.append)
+        self.after(100, self.check_alignment, pending, start, span, rate)
+
+    def check_alignment(self, pending, start, span, rate):
+        """Draw the overlay once the background alignment is done"""
+        if not pending:
+            self.after(100, self.check_alignment, pending, start, span, rate)
+            return
+        cmp = pending[0]
+        if isinstance(cmp, Exception):
+            self.ref_var.set("")
+            messagebox.showerror("Reference", str(cmp))
+            return
+        slot = cmp.slot
+        stop = min(start + span, len(cmp.samples))
+        fig, (ax1, ax2) = plt.subplots(2, 1, sharex=True)
+        # only the visible range is read; long ranges are drawn as min/max buckets
+        x, lo, hi = pyramid.Pyramid.build(cmp.samples[start:stop]).view(cmp.samples[start:stop], 0, stop - start,
+                                                                         LIVE_POINTS)
+        ax1.fill_between((x + start) / rate, lo, hi, step='post', label="capture")
+        a, b = max(start - int(cmp.lag), 0), max(stop - int(cmp.lag), 0)
+        x, lo, hi = slot.pyramid.view(slot.samples, a, b, LIVE_POINTS)
+        ax1.fill_between((x + cmp.lag) / rate, lo, hi, step='post', alpha=0.5, label="reference")
+        ax1.legend()
+        diff = cmp.difference(start, stop)
+        x, lo, hi = pyramid.Pyramid.build(diff).view(diff, 0, len(diff), LIVE_POINTS)
+        ax2.fill_between((x + start) / rate, lo, hi, step='post')
+        ax2.set_ylabel("Difference")
+        ax2.set_xlabel("Seconds")
+        sc = cmp.score(start, stop)
+        ax1.set_title("Lag %.2f samples, r = %.5f here (rms %.4g, peak %.4g)"
+                      % (cmp.lag, sc['correlation'], sc['rms'], sc['peak']))
+        plt.show(block=False)
+        self.ref_var.set("Summarizing...")
+        cmp.summarize()
+        self.after(200, self.check_summary, cmp)
+
+    def check_summary(self, cmp):
+        """Show the whole-capture score once the background summary is done"""
+        if cmp.summary is None:
+            self.after(200, self.check_summary, cmp)
+            return
+        s = cmp.summary
+        if isinstance(s, Exception):
+            self.ref_var.set("Summary failed")
+            messagebox.showerror("Reference", str(s))
+            return
+        self.ref_var.set("Whole capture: r = %.5f, rms %.4g, peak %.4g over %d samples"
+                         % (s['correlation'], s['rms'], s['peak'], s['samples']))
+
+    def on_counter(self):
+        """Reciprocal frequency count of the capture with Allan deviation"""
+        rate = self.rate_var.get()
+        r = counter.measure(self.Source(), self.thresh_var.get(), rate,
+                            self.gate_var.get() or None, self.nominal_var.get() or None)
+        if r is None:
+            messagebox.showinfo("Counter", "Fewer than two edges cross the threshold")
+            return
+        fig, (ax1, ax2) = plt.subplots(2, 1)
+        ax1.plot(np.arange(len(r['gate_frequency'])) * r['gate'], r['gate_frequency'])
+        ax1.set_xlabel("Seconds")
+        ax1.set_ylabel("Hz per %.3g s gate" % r['gate'])
+        title = "%.10g Hz from %d edges, jitter %.3g s" % (r['frequency'], r['edges'], r['jitter'])
+        if 'ppm' in r:
+            title += ", %+.3f ppm" % r['ppm']
+        ax1.set_title(title)
+        if r['adev']:
+            tau, adev = zip(*r['adev'])
+            ax2.loglog(tau, adev, marker='o')
+        ax2.set_xlabel("Tau (s)")
+        ax2.set_ylabel("Allan deviation")
+        plt.show()
+
+    def on_adc(self):
+        """ADC test over a captured sine: FFT metrics and histogram INL/DNL"""
+        samples = self.Load()
+        rate = self.rate_var.get()
+        # the FFT over the first 2**20 samples, the histogram over all of them
+        m = adc.spectrum_metrics(samples[:1 << 20], rate)
+        try:
+            lin, note = adc.linearity(samples), "Too few codes for INL/DNL"
+        except ValueError as e:
+            lin, note = None, str(e)
+        fig, (ax1, ax2, ax3) = plt.subplots(3, 1)
+        f = np.fft.rfftfreq(min(len(samples), 1 << 20), 1 / rate)
+        ax1.plot(f, m['spectrum_db'])
+        for h, freq, dbc in m['harmonics']:
+            ax1.annotate(str(h), (freq, dbc), ha='center')
+        ax1.set_ylabel("dBc")
+        ax1.set_title("%.6g Hz  SNR %.1f  SINAD %.1f dB  ENOB %.2f  SFDR %.1f dBc  THD %.1f dBc"
+                      % (m['frequency'], m['snr'], m['sinad'], m['enob'], m['sfdr'], m['thd']))
+        if lin is not None:
+            ax2.plot(lin['codes'], lin['dnl'])
+            ax3.plot(lin['codes'], lin['inl'])
+            ax2.set_title("%d missing codes" % len(lin['missing']))
+        else:
+            ax2.set_title(note)
+        ax2.set_ylabel("DNL (LSB)")
+        ax3.set_ylabel("INL (LSB)")
+        ax3.set_xlabel("Code")
+        plt.show()
+
+    def on_peaks(self):
+        """Peak search over the averaged spectrum; follows the stream when live"""
+        rate = self.rate_var.get()
+        if self.acq is not None:
+            # only frames newer than the last tick are transformed
+            self.spectrum = peaks.Averager(rate, depth=16)
+            self.spectrum_pos = self.ring.head
+            fig, ax = plt.subplots()
+            self.spectrum_line, = ax.plot([], [])
+            self.spectrum_marks, = ax.plot([], [], 'v')
+            ax.set_xlabel("Hz")
+            ax.set_ylabel("dB")
+            plt.show(block=False)
+            return
+        avg = peaks.Averager(rate)
+        samples = self.Source()
+        for a in range(0, len(samples), 1 << 20):
+            avg.feed(samples[a:a + (1 << 20)])
+        freq, db, found = peaks.search(avg)
+        plt.figure()
+        plt.plot(freq, db)
+        plt.plot(found['frequency'], found['level_db'], 'v')
+        for r in found:
+            plt.annotate("H%d" % r['harmonic'] if r['harmonic'] else "S", (r['frequency'], r['level_db']),
+                         ha='center', va='bottom')
+        plt.xlabel("Hz")
+        plt.ylabel("dB")
+        plt.show(block=False)
+        self.show_peaks(found)
+
+    def show_peaks(self, found):
+        """Spur table; click a heading to sort on it"""
+        top = ttk.Toplevel(title="Peaks (%d)" % len(found))
+        tree = ttk.Treeview(top, columns=peaks.COLUMNS, show='headings')
+
+        def fill(column, descending):
+            tree.delete(*tree.get_children())
+            for r in peaks.table(found, column, descending):
+                tree.insert('', END, values=("%.6g" % r['frequency'], "%.2f" % r['level_db'], "%.2f" % r['dbc'],
+                                             "%.1f" % r['above_floor'], r['harmonic'] or 'spur'))
+            tree.heading(column, command=lambda: fill(column, not descending))
+
+        for c in peaks.COLUMNS:
+            tree.heading(c, text=c, command=lambda c=c: fill(c, True))
+        fill('level_db', True)
+        tree.pack(fill=BOTH, expand=YES)
+
+    def spectrum_tick(self):
+        """Feed new live samples to the averager and redraw spectrum and peaks"""
+        data, self.spectrum_pos, lost = self.ring.read(self.spectrum_pos)
+        if not self.spectrum.feed(data):
+            return
+        freq, db, found = peaks.search(self.spectrum)
+        self.spectrum_line.set_data(freq, db)
+        self.spectrum_marks.set_data(found['frequency'], found['level_db'])
+        ax = self.spectrum_line.axes
+        spurs = found[found['harmonic'] == 0]
+        ax.set_title("%d harmonics, %d spurs%s" % ((found['harmonic'] > 1).sum(), len(spurs),
+                     ", worst %.1f dBc at %.6g Hz" % (spurs['dbc'][0], spurs['frequency'][0]) if len(spurs) else ""))
+        ax.relim()
+        ax.autoscale_view()
+        ax.figure.canvas.draw_idle()
+
+    def LoadPair(self):
+        """Channels A and B: two captures, or one capture interleaved A/B"""
+        if self.chb_var.get():
+            return self.Load(), capture.load(self.chb_var.get(), self.cast_var.get())
+        return capture.channels(self.Load(), 2)
+
+    def on_bode(self):
+        """Transfer function of channel B (response) over channel A (stimulus)"""
+        x, y = self.LoadPair()
+        r = transfer.response(x, y, self.rate_var.get())
+        f = r['frequency'][1:]
+        fig, axes = plt.subplots(4, 1, sharex=True)
+        for ax, key, label in zip(axes, ('magnitude_db', 'phase_deg', 'group_delay', 'coherence'),
+                                  ("Magnitude (dB)", "Phase (deg)", "Group delay (s)", "Coherence")):
+            ax.semilogx(f, r[key][1:])
+            ax.set_ylabel(label)
+        axes[0].semilogx(f, 20 * np.log10(np.abs(r['h2'][1:]) + 1e-30), alpha=0.5)
+        axes[0].legend(("H1", "H2"))
+        axes[-1].set_xlabel("Hz")
+        plt.show()
+
+    def on_delay(self):
+        """Delay of channel B behind A, its drift, and an aligned overlay"""
+        x, y = self.LoadPair()
+        rate = self.rate_var.get()
+        lag, coeff = delay.correlate(x, y)
+        centres, lags, coeffs = delay.drift(x, y)
+        fig, (ax1, ax2) = plt.subplots(2, 1)
+        ax1.plot(centres / rate, lags / rate)
+        ax1.set_xlabel("Seconds")
+        ax1.set_ylabel("Delay (s)")
+        ax1.set_title("B lags A by %.3f samples (%.4g s), r = %.3f" % (lag, lag / rate, coeff))
+        # a short window about the middle; deskew only what is drawn
+        view = min(len(x), len(y), LIVE_POINTS)
+        start = (min(len(x), len(y)) - view) // 2
+        t = np.arange(start, start + view)
+        ax2.plot(t, x[start:start + view], label="A")
+        ax2.plot(t, y[start:start + view], label="B", alpha=0.5)
+        if self.deskew_var.get():
+            ax2.plot(t, delay.FractionalDelay(-lag).render(y, start, start + view), label="B deskewed")
+        ax2.legend()
+        plt.show()
+
+    def Constellation(self):
+        """Plot constellation density and EVM of the capture as interleaved I/Q"""
+        mod = self.mod_var.get()
+        symbols, hist, edges, m = iq.analyze(self.Load(), self.sps_var.get(), mod)
+        plt.figure()
+        plt.imshow(np.log1p(hist.T), origin='lower', cmap='inferno',
+                   extent=(edges[0], edges[-1], edges[0], edges[-1]))
+        plt.title("%s  %d symbols  EVM %.2f%% (peak %.2f%%)  MER %.1f dB"
+                  % (mod, len(symbols), m['evm_rms'], m['evm_peak'], m['mer_db']))
+        plt.xlabel("I")
+        plt.ylabel("Q")
+        plt.show()
+
+    def Decode(self):
+        """Run the decoder stack (and hook) off the UI thread"""
+        if self.searching:
+            return
+        self.searching = True
+        self.progressbar.start(10)
+        key = None
+        if not self.hook_var.get():  # a hook has to see every batch, so never reuse a result
+            key = ('decode', self.capture_key(), self.derived_var.get(), self.rate_var.get(), self.stack_var.get())
+        args = (self.Source(), self.stack_var.get(), self.hook_var.get(), key)
+        Thread(target=self.decode_worker, args=args, daemon=True).start()
+        self.after(100, self.check_decode)
+
+    def decode_worker(self, rx_data1, spec, hook, key=None):
+        """Decode thread body, hands its result back through the queue"""
+        stack = runner = None
+        try:
+            stack = decoders.build(spec, self.plugins)
+            if hook:
+                runner = hooks.HookRunner(hooks.load_hook(hook))
+            if key is not None:
+                found = memory.GOVERNOR.cached(key, lambda: decoders.decode(rx_data1, stack))
+            else:
+                found = decoders.decode(rx_data1, stack, sink=runner.put if runner else None)
+            checked = None
+            if runner is not None:
+                checked = runner.close()
+                runner = None
+            self.queue.put((rx_data1, found, checked))
+        except Exception as e:
+            self.queue.put(e)
+        finally:
+            if runner is not None:
+                try:
+                    runner.close()  # decode failed; just stop the hook thread
+                except Exception:
+                    pass
+            if stack is not None:
+                stack.close()
+
+    def check_decode(self):
+        """Poll for the decode result and draw it on the UI thread"""
+        if self.queue.empty():
+            self.after(100, self.check_decode)
+            return
+        result = self.queue.get()
+        self.progressbar.stop()
+        self.searching = False
+        if isinstance(result, Exception):
+            messagebox.showerror("Decode", str(result))
+            return
+        rx_data1, found, checked = result
+        self.events = events.EventStore.from_annotations(found)
+        plt.figure()
+        rx_data1 = np.asarray(rx_data1)
+        plt.plot(rx_data1)
+        top = rx_data1.max()
+        for a in found[:500]:  # labelling every event would swamp the figure
+            color = 'red' if a['flags'] & decoders.FLAG_ERROR else 'green'
+            plt.axvspan(a['start'], a['end'], color=color, alpha=0.15)
+            plt.text(a['start'], top, "%02X" % a['value'], fontsize=7)
+        title = "%d annotations" % len(found)
+        if checked is not None:
+            flagged, summary = checked
+            title += ", %d flagged by hook" % len(flagged)
+            if summary is not None:
+                title += ": %s" % (summary,)
+        plt.title(title)
         plt.show()
             
 def on_closing():
@@ -0,0 +1,63 @@
+# -*- coding: utf-8 -*-
+"""
+Archive tests: captures read back unchanged and repeats are stored once.
+
+Run from the repository root with python -m unittest discover tests.
+"""
+
+import functools
+import pathlib
+import sys
+import tempfile
+import unittest
+from unittest import mock
+
+import numpy as np
+
+sys.path.insert(0, str(pathlib.Path(__file__).resolve().parents[1]))
+
+import archive  # noqa: E402
+import capture  # noqa: E402
+import workers  # noqa: E402
+
+
+def signal(n, seed):
+    return np.random.default_rng(seed).integers(0, 4096, n).astype(np.uint16)
+
+
+class RoundTripTest(unittest.TestCase):
+
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+        self.store = archive.Archive(self.tmp.name)
+        self.x = signal(600000, 1)
+
+    def tearDown(self):
+        self.tmp.cleanup()
+
+    def test_read_back(self):
+        path, stats = self.store.put('a', self.x, 1e6, 12.5)
+        self.assertEqual(archive.info(path), ('uint16', 1e6, 12.5, len(self.x)))
+        np.testing.assert_array_equal(archive.read(path), self.x)
+        np.testing.assert_array_equal(archive.read(path, 123457, 400001), self.x[123457:400001])
+        v = archive.VirtualCapture(path)
+        v.seek(capture.HEADER_SIZE + 2 * 1001)
+        np.testing.assert_array_equal(np.frombuffer(v.read(2 * 5000), np.uint16), self.x[1001:6001])
+
+    def test_extract_in_parallel(self):
+        path, _ = self.store.put('a', self.x, 1e6)
+        with mock.patch.object(archive, 'map_chunks', functools.partial(workers.map_chunks, workers=4)):
+            out = archive.extract(path, pathlib.Path(self.tmp.name) / ('a' + capture.SUFFIX))
+        self.assertEqual(capture.read_header(out)[1:], (1e6, 0.0))
+        np.testing.assert_array_equal(capture.load_binary(out), self.x)
+
+    def test_repeats_stored_once(self):
+        self.store.put('a', self.x, 1e6)
+        y = np.concatenate((signal(50000, 2), self.x))  # same signal, shifted
+        path, stats = self.store.put('b', y, 1e6)
+        self.assertLess(stats['new'], stats['chunks'] // 2)
+        np.testing.assert_array_equal(archive.read(path), y)
+
+
+if __name__ == '__main__':
+    unittest.main()
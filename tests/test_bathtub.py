@@ -0,0 +1,61 @@
+# -*- coding: utf-8 -*-
+"""
+Bathtub tests: dual-Dirac fits on clean synthetic eyes.
+
+Run from the repository root with python -m unittest discover tests.
+"""
+
+import pathlib
+import sys
+import unittest
+
+import numpy as np
+
+sys.path.insert(0, str(pathlib.Path(__file__).resolve().parents[1]))
+
+import bathtub  # noqa: E402
+import eye  # noqa: E402
+
+
+def nrz(sps, noise, n=20000, seed=1):
+    """Random NRZ between 1000 and 3000 with a quarter-UI rise and gaussian noise"""
+    rng = np.random.default_rng(seed)
+    bits = rng.integers(0, 2, n)
+    t = np.arange(int(n * sps))
+    x = np.where(bits[np.minimum((t / sps).astype(int), n - 1)], 3000.0, 1000.0)
+    width = int(sps / 4)
+    return np.convolve(x, np.ones(width) / width, 'same') + rng.normal(0, noise, len(x))
+
+
+class CleanEyeTest(unittest.TestCase):
+
+    def test_finite_openings(self):
+        for sps in (16, 16.37, 64):
+            for noise in (30, 60):
+                with self.subTest(sps=sps, noise=noise):
+                    x = nrz(sps, noise)
+                    folded = eye.Eye(sps, eye.best_phase(x, sps, 2000), (0, 4000), threshold=2000).add(x)
+                    r = bathtub.analyze(folded)
+                    h, v = r['horizontal'], r['vertical']
+                    self.assertNotEqual(h['fit'], 'no fit')
+                    self.assertTrue(0.5 < h['opening'] <= 1.0, h['opening'])
+                    # vertical: swing less 2 * Q(1e-12) * noise
+                    self.assertAlmostEqual(v['opening'], 2000 - 2 * 7.03 * noise, delta=0.1 * 2000)
+                    inside = (r['levels'] > 1200) & (r['levels'] < 2800)
+                    self.assertFalse(np.isnan(r['contour_edges'][inside, 0]).any())
+
+    def test_closed_eye_has_no_opening(self):
+        x = np.random.default_rng(2).normal(2000, 500, 1 << 16)
+        h = bathtub.analyze(eye.Eye(16, 0, (0, 4000), threshold=2000).add(x))['horizontal']
+        self.assertIn(h['opening'], (None, 0.0))
+        self.assertEqual(h['opening'] is None, h['fit'] == 'no fit')
+
+    def test_threshold_past_the_levels(self):
+        x = nrz(16, 30)
+        r = bathtub.analyze(eye.Eye(16, eye.best_phase(x, 16, 2000), (0, 1500), threshold=2000).add(x))
+        self.assertEqual(r['row'], len(r['levels']) - 1)
+        self.assertEqual(len(r['ber'][:, r['row']]), len(r['phases']))
+
+
+if __name__ == '__main__':
+    unittest.main()
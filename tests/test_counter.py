@@ -0,0 +1,43 @@
+# -*- coding: utf-8 -*-
+"""
+Counter tests: frequency of noisy and glitchy synthetic clocks.
+
+Run from the repository root with python -m unittest discover tests.
+"""
+
+import pathlib
+import sys
+import unittest
+
+import numpy as np
+
+sys.path.insert(0, str(pathlib.Path(__file__).resolve().parents[1]))
+
+import counter  # noqa: E402
+
+RATE = 1e6
+FREQ = 12345.678
+N = 2000000
+
+
+class CounterTest(unittest.TestCase):
+
+    def test_noisy_sine(self):
+        t = np.arange(N) / RATE
+        x = 2000 + 1000 * np.sin(2 * np.pi * FREQ * t) + np.random.default_rng(1).normal(0, 30, N)
+        for chunk in (counter.CHUNK, 1 << 15):
+            r = counter.measure(np.round(x).astype(np.uint16), 2000, RATE, nominal=FREQ, chunk=chunk)
+            self.assertEqual(r['edges'], int(FREQ * N / RATE))
+            self.assertLess(abs(r['ppm']), 0.1)
+
+    def test_glitches_rejected(self):
+        x = np.where(np.arange(N) * FREQ / RATE % 1 < 0.5, 3000, 1000).astype(np.uint16)
+        rising = np.flatnonzero(np.diff(x.astype(np.int32)) > 0) + 1
+        x[rising[::3] + 5] = 900  # a dip just after every third rising edge
+        r = counter.measure(x, 2000, RATE, nominal=FREQ, hysteresis=0, chunk=1 << 15)
+        self.assertEqual(r['edges'], len(rising))
+        self.assertLess(abs(r['ppm']), 1)
+
+
+if __name__ == '__main__':
+    unittest.main()
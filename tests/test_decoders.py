@@ -0,0 +1,85 @@
+# -*- coding: utf-8 -*-
+"""
+Decoder stack tests: stream tails through stacked buffering decoders.
+
+Run from the repository root with python -m unittest discover tests.
+"""
+
+import pathlib
+import sys
+import unittest
+
+import numpy as np
+
+sys.path.insert(0, str(pathlib.Path(__file__).resolve().parents[1]))
+
+import decoders  # noqa: E402
+
+
+def square(n=10000, half=1000):
+    """Square wave of +-1000 about 2000, edges every half samples"""
+    return np.where(np.arange(n) // half % 2, 3000, 1000).astype(np.uint16)
+
+
+def edges(logic):
+    return list(np.flatnonzero(np.diff(logic.astype(np.int8))) + 1)
+
+
+class StackFlushTest(unittest.TestCase):
+
+    def run_stack(self, spec, x, batch=1024):
+        stack = decoders.build(spec, decoders.load_plugins(pathlib.Path('no plugins')))
+        try:
+            parts = [stack.feed(x[s:s + batch]) for s in range(0, len(x), batch)]
+            parts.append(stack.flush())
+        finally:
+            stack.close()
+        return np.concatenate(parts)
+
+    def test_buffering_after_buffering(self):
+        x = square()
+        logic = self.run_stack('baseline | tracker:threshold=0', x)
+        self.assertEqual(len(logic), len(x))
+        self.assertEqual(edges(logic), list(range(1000, len(x), 1000)))
+
+    def test_pipeline_matches_stack(self):
+        x = square()
+        stack = decoders.build('baseline | tracker:threshold=0',
+                               decoders.load_plugins(pathlib.Path('no plugins')))
+        pipe = decoders.Pipeline(stack)
+        for s in range(0, len(x), 1024):
+            pipe.put(x[s:s + 1024])
+        pipe.close()
+        logic = np.concatenate(list(pipe.results()))
+        self.assertEqual(len(logic), len(x))
+        self.assertEqual(edges(logic), list(range(1000, len(x), 1000)))
+
+
+class Failing(decoders.Decoder):
+    input = 'samples'
+
+    def feed(self, batch):
+        raise ValueError("broken decoder")
+
+
+class DecodeErrorTest(unittest.TestCase):
+
+    def test_error_reaches_caller_and_stops_producer(self):
+        stack = decoders.Stack([Failing()])
+        with self.assertRaises(ValueError):
+            decoders.decode(np.zeros(1 << 16, np.uint16), stack, batch=16)
+
+
+class SetOptionsTest(unittest.TestCase):
+
+    def test_other_stages_and_options_kept(self):
+        spec = 'baseline:window=801 | tracker:threshold=0;attack=64 | myplugin:x=1 | uart:bit=16,bits=7'
+        out = decoders.set_options(spec, 'uart', bit='12.500')
+        self.assertEqual(out, 'baseline:window=801 | tracker:threshold=0;attack=64 | myplugin:x=1 | '
+                              'uart:bit=12.500;bits=7')
+        self.assertEqual(decoders.set_options('slicer | uart', 'slicer', threshold=1500),
+                         'slicer:threshold=1500 | uart')
+
+
+if __name__ == '__main__':
+    unittest.main()
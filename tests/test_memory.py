@@ -0,0 +1,65 @@
+# -*- coding: utf-8 -*-
+"""
+Memory governor tests: eviction order, spilling and reservations.
+
+Run from the repository root with python -m unittest discover tests.
+"""
+
+import pathlib
+import sys
+import tempfile
+import unittest
+
+import numpy as np
+
+sys.path.insert(0, str(pathlib.Path(__file__).resolve().parents[1]))
+
+import memory  # noqa: E402
+
+
+class GovernorTest(unittest.TestCase):
+
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+        self.gov = memory.Governor(budget=10000, directory=self.tmp.name)
+
+    def tearDown(self):
+        self.gov.clear()
+        self.tmp.cleanup()
+
+    def resident(self):
+        return sorted(k for k, e in self.gov.entries.items() if e.value is not None)
+
+    def test_cheap_big_entries_go_first(self):
+        self.gov.register('cheap', np.zeros(4000, np.uint8), cost=0.001)
+        self.gov.register('costly', np.zeros(4000, np.uint8), cost=1.0)
+        self.gov.register('new', np.zeros(4000, np.uint8), cost=0.01)
+        self.assertEqual(self.resident(), ['costly', 'new'])
+        self.assertEqual(self.gov.usage()['spilled'], 1)
+        self.assertEqual(self.gov.get('cheap').sum(), 0)  # back from the spill file
+
+    def test_stale_entries_go_before_fresh_ones(self):
+        for key in 'abc':
+            self.gov.register(key, np.zeros(4000, np.uint8), cost=0.01)
+        self.assertEqual(self.resident(), ['b', 'c'])  # the clock has moved on past a
+        self.gov.get('b')
+        self.gov.register('d', np.zeros(4000, np.uint8), cost=0.01)
+        self.assertEqual(self.resident(), ['b', 'd'])
+
+    def test_reserve_beyond_budget_evicts_nothing(self):
+        self.gov.register('a', np.zeros(4000, np.uint8), cost=0.01)
+        self.assertFalse(self.gov.reserve(20000))
+        self.assertEqual(self.resident(), ['a'])
+        self.assertEqual(self.gov.usage()['spills'], 0)
+
+    def test_values_in_use_are_kept(self):
+        held = self.gov.register('held', np.zeros(4000, np.uint8), cost=0.001)
+        self.gov.register('free', np.zeros(4000, np.uint8), cost=0.01)
+        self.assertTrue(self.gov.reserve(4000))
+        self.assertEqual(self.resident(), ['held'])
+        self.assertFalse(self.gov.reserve(9000))  # only the held one is left
+        self.assertIs(self.gov.get('held'), held)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,71 @@
+# -*- coding: utf-8 -*-
+"""
+Recorder tests: samples keep their place in the file across overruns.
+
+Run from the repository root with python -m unittest discover tests.
+"""
+
+import json
+import pathlib
+import sys
+import tempfile
+import unittest
+
+import numpy as np
+
+sys.path.insert(0, str(pathlib.Path(__file__).resolve().parents[1]))
+
+import acquire  # noqa: E402
+import capture  # noqa: E402
+import recorder  # noqa: E402
+
+
+def ramp(start, stop):
+    """Sample k is k % 60000 + 1, so zeros mark what was lost"""
+    return (np.arange(start, stop) % 60000 + 1).astype(np.uint16)
+
+
+class OverrunTest(unittest.TestCase):
+
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+        self.path = pathlib.Path(self.tmp.name) / ('rec' + capture.SUFFIX)
+
+    def tearDown(self):
+        self.tmp.cleanup()
+
+    def record(self, chunks):
+        ring = acquire.RingBuffer(1000)
+        ring.write(chunks[0])  # already lapped when the recorder starts at 0
+        rec = recorder.Recorder(ring, self.path, 1.0, start_pos=0, block_bytes=512)
+        for chunk in chunks[1:]:
+            rec.drain_thread.join(0.05)  # let the drain catch up
+            ring.write(chunk)
+        stats = rec.stop()
+        return stats, np.asarray(capture.load_binary(self.path))
+
+    def test_lost_samples_are_zeroed_in_place(self):
+        stats, x = self.record([ramp(0, 3000), ramp(3000, 3500), ramp(3500, 4000)])
+        self.assertEqual(len(x), 4000)
+        self.assertTrue((x[:2000] == 0).all())
+        np.testing.assert_array_equal(x[2000:], ramp(2000, 4000))
+        self.assertEqual(stats['written'], 2000)
+        self.assertEqual(stats['lost'], 2000)
+        overruns = json.loads(pathlib.Path(str(self.path) + '.overruns.json').read_text())
+        self.assertEqual(overruns, [[0, 2000]])
+
+    def test_gap_at_the_end(self):
+        ring = acquire.RingBuffer(1000)
+        ring.write(ramp(0, 500))
+        rec = recorder.Recorder(ring, self.path, 1.0, start_pos=0, block_bytes=512)
+        rec.drain_thread.join(0.1)
+        ring.skip(300)  # a source dropout: never written, so lost to the recorder
+        stats = rec.stop()
+        x = np.asarray(capture.load_binary(self.path))
+        self.assertEqual(len(x), 800)
+        np.testing.assert_array_equal(x[:500], ramp(0, 500))
+        self.assertEqual(stats['written'], 500)
+
+
+if __name__ == '__main__':
+    unittest.main()
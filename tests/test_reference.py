@@ -0,0 +1,56 @@
+# -*- coding: utf-8 -*-
+"""
+Reference slot tests: clearing slots whose file is still mapped.
+
+Run from the repository root with python -m unittest discover tests.
+"""
+
+import pathlib
+import sys
+import tempfile
+import unittest
+from unittest import mock
+
+import numpy as np
+
+sys.path.insert(0, str(pathlib.Path(__file__).resolve().parents[1]))
+
+import reference  # noqa: E402
+
+
+class SlotsTest(unittest.TestCase):
+
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+        self.directory = pathlib.Path(self.tmp.name)
+
+    def tearDown(self):
+        self.tmp.cleanup()
+
+    def test_clear_removes_file(self):
+        slots = reference.Slots(self.directory)
+        slots.store(1, np.arange(5000, dtype=np.uint16), 1.0, disk=True)
+        slots.clear(1)
+        self.assertEqual(list(self.directory.iterdir()), [])
+
+    def test_clear_while_mapped(self):
+        slots = reference.Slots(self.directory)
+        slot = slots.store(1, np.arange(5000, dtype=np.uint16), 1.0, disk=True)
+        cmp = reference.Compare(slot, np.arange(5000, dtype=np.uint16), lag=0.0)
+        unlink = pathlib.Path.unlink
+
+        def in_use(path, missing_ok=False):
+            if path.suffix != reference.TRASH:
+                raise PermissionError(13, "in use", str(path))
+            unlink(path, missing_ok=missing_ok)
+
+        with mock.patch.object(pathlib.Path, 'unlink', in_use):
+            slots.clear(1)
+            self.assertEqual(len(cmp.slot.samples), 0)
+            slots.store(1, np.full(100, 7, np.uint16), 1.0, disk=True)
+        self.assertEqual(len(reference.Slots(self.directory).get(1).samples), 100)
+        self.assertFalse(list(self.directory.glob('*' + reference.TRASH)))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,77 @@
+# -*- coding: utf-8 -*-
+"""
+Trigger tests: decoder-stack triggers across resets and after stopping.
+
+Run from the repository root with python -m unittest discover tests.
+"""
+
+import pathlib
+import sys
+import time
+import unittest
+
+import numpy as np
+
+sys.path.insert(0, str(pathlib.Path(__file__).resolve().parents[1]))
+
+import acquire  # noqa: E402
+import decoders  # noqa: E402
+import triggers  # noqa: E402
+
+SPEC = 'slicer:threshold=2000 | uart:bit=16'
+
+
+def uart(values, bit=16, idle=64):
+    """8N1 frames between 1000 and 3000, idle high"""
+    bits = []
+    for v in values:
+        bits += [0] + [(v >> k) & 1 for k in range(8)] + [1, 1]
+    return np.where(np.repeat([1] * (idle // bit) + bits, bit), 3000, 1000).astype(np.uint16)
+
+
+class Counted:
+    """Builds stacks and remembers which were closed"""
+
+    def __init__(self):
+        self.built = []
+        self.closed = 0
+
+    def __call__(self):
+        stack = decoders.build(SPEC, decoders.load_plugins(pathlib.Path('no plugins')))
+        close = stack.close
+
+        def counted():
+            self.closed += 1
+            close()
+
+        stack.close = counted
+        self.built.append(stack)
+        return stack
+
+
+class StackTriggerTest(unittest.TestCase):
+
+    def test_match_does_not_span_reset(self):
+        trig = triggers.StackTrigger(Counted(), triggers.ByteSequence([0x7e, 0x01]), 'uart')
+        self.assertEqual(trig.scan(0, uart([0x7e])), [])
+        trig.reset()  # an overrun: the 0x01 below does not follow the 0x7e
+        self.assertEqual(trig.scan(5000, uart([0x01])), [])
+        self.assertEqual(len(trig.scan(10000, uart([0x7e, 0x01]))), 1)
+
+    def test_stop_closes_stacks(self):
+        build = Counted()
+        trig = triggers.StackTrigger(build, triggers.ByteSequence([0x55]), 'uart')
+        ring = acquire.RingBuffer(1 << 16)
+        hits = []
+        thread = triggers.TriggerThread(ring, [trig], lambda index, name: hits.append(index))
+        ring.write(uart([0x55, 0x55]))
+        deadline = time.time() + 5
+        while len(hits) < 2 and time.time() < deadline:
+            time.sleep(0.01)
+        thread.stop()
+        self.assertEqual(len(hits), 2)
+        self.assertEqual(build.closed, len(build.built))
+
+
+if __name__ == '__main__':
+    unittest.main()
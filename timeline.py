@@ -0,0 +1,200 @@
+# -*- coding: utf-8 -*-
+"""
+Multi-capture timeline.
+
+Sequential capture files are stitched into one logical timeline with
+absolute timestamps. Each file is scanned once into a sparse index (the byte
+offset of every STRIDE-th sample) which is cached next to the captures, so
+seeking and rendering a window only opens the files that overlap it and only
+parses the lines that are needed.
+"""
+
+import datetime
+import json
+import pathlib
+import re
+
+import numpy as np
+
+import archive
+import capture
+import hdf5io
+
+STRIDE = 4096
+INDEX_NAME = '.timeline.json'
+STAMP = re.compile(r'(\d{8})[_T-]?(\d{6})')
+PATTERNS = ('*.txt', '*' + capture.SUFFIX, '*' + archive.SUFFIX) + tuple('*' + s for s in hdf5io.SUFFIXES)
+
+
+def scan_text(path, block=1 << 24):
+    """Sample count and byte offsets of every STRIDE-th line of a text capture"""
+    offsets = [0]
+    count = 0
+    pos = 0
+    last = b'\n'
+    with open(path, 'rb') as f:
+        while True:
+            data = f.read(block)
+            if not data:
+                break
+            nl = np.flatnonzero(np.frombuffer(data, np.uint8) == 10) + pos + 1
+            # line k + 1 starts after the k-th newline
+            first = (-count - 1) % STRIDE
+            offsets.extend(nl[first::STRIDE].tolist())
+            count += len(nl)
+            pos += len(data)
+            last = data[-1:]
+    if last != b'\n':
+        count += 1
+    elif offsets[-1] == pos:
+        offsets.pop()  # an offset at EOF does not start a sample
+    return count, offsets
+
+
+def parse_stamp(path):
+    """Absolute start time encoded as YYYYmmdd_HHMMSS in the file name, or None"""
+    m = STAMP.search(pathlib.Path(path).stem)
+    if not m:
+        return None
+    return datetime.datetime.strptime(m.group(1) + m.group(2), '%Y%m%d%H%M%S').timestamp()
+
+
+class Segment:
+    """One capture file placed on the timeline"""
+
+    def __init__(self, path, start, rate, count, offsets, size, mtime, dtype=None):
+        self.path = str(path)
+        self.dtype = dtype  # set for binary captures, which need no line index
+        self.start = start
+        self.rate = rate
+        self.count = count
+        self.offsets = offsets
+        self.size = size
+        self.mtime = mtime
+
+    @property
+    def end(self):
+        return self.start + self.count / self.rate
+
+    @classmethod
+    def scan(cls, path, rate):
+        st = pathlib.Path(path).stat()
+        if str(path).endswith(hdf5io.SUFFIXES):
+            dtype, rate, start, count = hdf5io.info(path)
+            return cls(path, start, rate, count, [], st.st_size, st.st_mtime, dtype)
+        if str(path).endswith(archive.SUFFIX):
+            dtype, rate, start, count = archive.info(path)
+            return cls(path, start, rate, count, [], st.st_size, st.st_mtime, dtype)
+        header = capture.read_header(path)
+        if header is not None:
+            dtype, rate, start = header
+            count = (st.st_size - capture.HEADER_SIZE) // np.dtype(dtype).itemsize
+            return cls(path, start, rate, count, [], st.st_size, st.st_mtime, dtype)
+        count, offsets = scan_text(path)
+        start = parse_stamp(path)
+        if start is None:
+            # no stamp, assume the file was closed when recording stopped
+            start = st.st_mtime - count / rate
+        return cls(path, start, rate, count, offsets, st.st_size, st.st_mtime)
+
+    def stale(self):
+        st = pathlib.Path(self.path).stat()
+        return st.st_size != self.size or st.st_mtime != self.mtime
+
+    def read(self, i0, i1, dtype='uint16'):
+        """Samples [i0, i1) of this file, parsing only the lines needed"""
+        i0 = max(0, i0)
+        i1 = min(self.count, i1)
+        if i1 <= i0:
+            return np.empty(0, dtype)
+        if self.path.endswith(hdf5io.SUFFIXES):
+            return hdf5io.read(self.path, i0, i1).astype(dtype)
+        if self.path.endswith(archive.SUFFIX):
+            return archive.read(self.path, i0, i1).astype(dtype)
+        if self.dtype is not None:
+            return np.array(capture.load_binary(self.path)[i0:i1]).astype(dtype)
+        k = i0 // STRIDE
+        with open(self.path, 'rb') as f:
+            f.seek(self.offsets[k])
+            lines = []
+            for _ in range(i1 - k * STRIDE):
+                lines.append(f.readline())
+        lines = lines[i0 - k * STRIDE:]
+        return capture.parse_lines(lines, dtype)
+
+    def to_json(self):
+        keys = ('path', 'start', 'rate', 'count', 'offsets', 'size', 'mtime', 'dtype')
+        return {k: getattr(self, k) for k in keys}
+
+
+class Timeline:
+    """Captures sorted by start time, with gaps between them"""
+
+    def __init__(self, segments):
+        self.segments = sorted(segments, key=lambda s: s.start)
+        self.starts = np.array([s.start for s in self.segments])
+        self.ends = np.array([s.end for s in self.segments])
+        # latest end among segments 0..k; nondecreasing, so it can be bisected too
+        self.reach = np.maximum.accumulate(self.ends) if len(self.ends) else self.ends
+
+    @classmethod
+    def open(cls, directory, rate, patterns=PATTERNS):
+        """Index every capture in directory, reusing the cached index when fresh"""
+        directory = pathlib.Path(directory)
+        cache = {}
+        index = directory / INDEX_NAME
+        if index.exists():
+            for d in json.loads(index.read_text()):
+                cache[d['path']] = Segment(**d)
+        segments = []
+        for path in sorted(p for pattern in patterns for p in directory.glob(pattern)):
+            seg = cache.get(str(path))
+            if seg is None or (seg.dtype is None and seg.rate != rate) or seg.stale():
+                seg = Segment.scan(path, rate)
+            segments.append(seg)
+        try:
+            index.write_text(json.dumps([s.to_json() for s in segments]))
+        except OSError:
+            pass  # read-only archive, index again next time
+        return cls(segments)
+
+    @property
+    def start(self):
+        return self.starts[0] if len(self.starts) else 0.0
+
+    @property
+    def end(self):
+        return self.ends.max() if len(self.ends) else 0.0
+
+    def gaps(self, tolerance=1.5):
+        """(gap start, gap end) pairs where no capture covers the timeline"""
+        out = []
+        reach = self.ends[0] if len(self.ends) else 0.0
+        for seg in self.segments[1:]:
+            if seg.start - reach > tolerance / seg.rate:
+                out.append((reach, seg.start))
+            reach = max(reach, seg.end)
+        return out
+
+    def overlapping(self, t0, t1):
+        """Segments intersecting [t0, t1), found by bisection without opening any file"""
+        lo = int(np.searchsorted(self.reach, t0, 'right'))  # every segment before lo ends by t0
+        hi = int(np.searchsorted(self.starts, t1, 'left'))
+        return [s for s in self.segments[lo:hi] if s.end > t0]
+
+    def seek(self, t):
+        """(segment, sample index) at absolute time t, or (None, 0) in a gap"""
+        for seg in self.overlapping(t, t + 1e-12):
+            return seg, int((t - seg.start) * seg.rate)
+        return None, 0
+
+    def window(self, t0, t1, dtype='uint16'):
+        """List of (absolute times, samples) for every capture overlapping [t0, t1)"""
+        out = []
+        for seg in self.overlapping(t0, t1):
+            i0 = int(np.floor((t0 - seg.start) * seg.rate))
+            i1 = int(np.ceil((t1 - seg.start) * seg.rate))
+            data = seg.read(i0, i1, dtype)
+            first = max(i0, 0)
+            out.append((seg.start + (first + np.arange(len(data))) / seg.rate, data))
+        return out
@@ -0,0 +1,127 @@
+# -*- coding: utf-8 -*-
+"""
+Adaptive threshold slicer for signals whose levels fade or wander.
+
+Levels are estimated per block of samples, not per sample: each block is
+split at its own midrange, and the means of its upper and lower parts pull
+the tracked high and low levels with separate attack and decay time
+constants. A block without a transition only moves the level it sits at.
+The threshold ramps across each block from the previous midpoint to the new
+one, and slicing is a vector compare against it with hysteresis; samples
+inside the hysteresis band hold the previous decision by a forward fill.
+Only the per-block scalar update is sequential; per sample the work is a
+few whole-array operations, like the fixed threshold slicer.
+"""
+
+import numpy as np
+
+BLOCK = 256
+
+
+class TrackingSlicer:
+    """Streaming samples to logic with a threshold midway between tracked levels
+
+    attack and decay are time constants in samples for a level moving out
+    (the swing growing) and in; hysteresis is a fraction of the high - low
+    swing; min_swing is the smallest block swing, as a fraction of the
+    tracked one, that counts as holding both levels.
+    """
+
+    def __init__(self, threshold=1000, attack=512, decay=8192, hysteresis=0.1,
+                 min_swing=0.5, block=BLOCK):
+        self.threshold = float(threshold)
+        self.attack = 1 - np.exp(-block / attack)
+        self.decay = 1 - np.exp(-block / decay)
+        self.hysteresis = hysteresis
+        self.min_swing = min_swing
+        self.block = block
+        self.high = self.low = None
+        self.state = 0
+        self.tail = np.empty(0, np.float32)
+        self.ramp = (np.arange(1, block + 1) / block).astype(np.float32)
+
+    def _levels(self, blocks):
+        """Threshold and hysteresis half-width at the end of every block"""
+        mx, mn = blocks.max(axis=1), blocks.min(axis=1)
+        upper = blocks >= ((mx + mn) / 2)[:, None]
+        n_up = np.count_nonzero(upper, axis=1)
+        s_up = blocks.sum(axis=1, where=upper, dtype=np.float64)
+        total = blocks.sum(axis=1, dtype=np.float64)
+        with np.errstate(invalid='ignore', divide='ignore'):
+            hi_obs = (s_up / n_up).tolist()
+            lo_obs = ((total - s_up) / (self.block - n_up)).tolist()
+        mean = (total / self.block).tolist()
+        mx, mn = mx.tolist(), mn.tolist()
+        if self.high is None:
+            self.high, self.low = max(mx[0], self.threshold), min(mn[0], self.threshold)
+        thr = [0.0] * len(mx)
+        half = [0.0] * len(mx)
+        high, low, attack, decay, min_swing = self.high, self.low, self.attack, self.decay, self.min_swing
+        for k in range(len(mx)):
+            h = l = None
+            if mx[k] > mn[k] and mx[k] - mn[k] >= min_swing * (high - low):  # both levels seen
+                h, l = hi_obs[k], lo_obs[k]
+            elif 2 * mean[k] >= high + low:
+                h = mean[k]
+            else:
+                l = mean[k]
+            if h is not None:
+                high += (attack if h > high else decay) * (h - high)
+            if l is not None:
+                low += (attack if l < low else decay) * (l - low)
+            thr[k] = (high + low) / 2
+            half[k] = self.hysteresis * (high - low) / 2
+        self.high, self.low = high, low
+        return np.array(thr, np.float32), np.array(half, np.float32)
+
+    def _slice(self, x):
+        blocks = x.reshape(-1, self.block)
+        thr, half = self._levels(blocks)
+        prev = np.concatenate(([self.threshold], thr[:-1])).astype(np.float32)
+        level = prev[:, None] + (thr - prev)[:, None] * self.ramp
+        self.threshold = float(thr[-1])
+        d = blocks - level
+        out = self._compare((d >= half[:, None]).ravel(), (d < -half[:, None]).ravel())
+        return out, level.ravel()
+
+    def _compare(self, high, low):
+        """high where above the band; inside it (neither) hold the last decision"""
+        out = high.view(np.uint8)
+        inside = ~(high | low)
+        if inside.any():
+            # runs of in-band samples take the decision just before them
+            edges = np.diff(inside.view(np.int8), prepend=np.int8(0), append=np.int8(0))
+            starts, stops = np.flatnonzero(edges == 1), np.flatnonzero(edges == -1)
+            before = np.where(starts > 0, out[np.maximum(starts - 1, 0)], self.state)
+            out = out.copy()
+            out[inside] = np.repeat(before, stops - starts)
+        if len(out):
+            self.state = int(out[-1])
+        return out
+
+    def feed(self, batch, levels=False):
+        """Logic for every whole block so far (and the threshold used, if levels)"""
+        x = np.concatenate((self.tail, np.asarray(batch, np.float32)))
+        n = len(x) // self.block * self.block
+        self.tail = x[n:]
+        if not n:
+            empty = np.empty(0, np.uint8)
+            return (empty, np.empty(0)) if levels else empty
+        out, level = self._slice(x[:n])
+        return (out, level) if levels else out
+
+    def flush(self, levels=False):
+        """Logic for the last partial block at the last threshold"""
+        x, self.tail = self.tail, np.empty(0, np.float32)
+        level = np.full(len(x), self.threshold, np.float32)
+        band = self.hysteresis * ((self.high - self.low) / 2 if self.high is not None else 0.0)
+        out = self._compare(x - level >= band, x - level < -band)
+        return (out, level) if levels else out
+
+
+def slice_capture(x, threshold=1000, batch=1 << 20, **options):
+    """(logic, threshold per sample) of a whole capture"""
+    s = TrackingSlicer(threshold, **options)
+    parts = [s.feed(x[a:a + batch], levels=True) for a in range(0, len(x), batch)]
+    parts.append(s.flush(levels=True))
+    return np.concatenate([p[0] for p in parts]), np.concatenate([p[1] for p in parts])
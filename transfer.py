@@ -0,0 +1,60 @@
+# -*- coding: utf-8 -*-
+"""
+Frequency response (Bode) from a stimulus and a response channel.
+
+Cross and auto spectra are Welch averages over Hann-windowed, 50 % overlapped
+segments. Segments are split across the thread pool, each worker doing one
+batched FFT over a strided view of its share, and the spectra are summed.
+H1 = Sxy / Sxx suits noise on the output, H2 = Syy / Syx noise on the input;
+coherence shows where either can be trusted.
+"""
+
+import numpy as np
+
+from workers import map_chunks
+
+
+def welch(x, y, nperseg=4096, batch=256):
+    """(frequencies in cycles/sample, Sxx, Syy, Sxy) averaged over segments"""
+    n = min(len(x), len(y))
+    nperseg = min(nperseg, n)
+    step = nperseg // 2
+    count = (n - nperseg) // step + 1
+    window = np.hanning(nperseg)
+
+    def work(s, e):
+        # segments s..e-1 as one strided 2-D block, no copies until the FFT
+        lo, hi = s * step, (e - 1) * step + nperseg
+        xs = np.lib.stride_tricks.sliding_window_view(np.asarray(x[lo:hi], np.float64), nperseg)[::step]
+        ys = np.lib.stride_tricks.sliding_window_view(np.asarray(y[lo:hi], np.float64), nperseg)[::step]
+        X = np.fft.rfft((xs - xs.mean(axis=1, keepdims=True)) * window, axis=1)
+        Y = np.fft.rfft((ys - ys.mean(axis=1, keepdims=True)) * window, axis=1)
+        return ((X.real ** 2 + X.imag ** 2).sum(axis=0), (Y.real ** 2 + Y.imag ** 2).sum(axis=0),
+                (np.conj(X) * Y).sum(axis=0))
+
+    parts = map_chunks(work, count, batch)
+    sxx, syy, sxy = (np.sum(p, axis=0) / count for p in zip(*parts))
+    return np.fft.rfftfreq(nperseg), sxx, syy, sxy
+
+
+def response(x, y, rate, nperseg=4096):
+    """H1, H2, coherence, magnitude, phase and group delay of y relative to x"""
+    f, sxx, syy, sxy = welch(x, y, nperseg)
+    with np.errstate(divide='ignore', invalid='ignore'):
+        h1 = sxy / sxx
+        h2 = syy / np.conj(sxy)
+        coherence = np.abs(sxy) ** 2 / (sxx * syy)
+    phase = np.unwrap(np.angle(h1))
+    freq = f * rate
+    delay = np.full(len(freq), np.nan)
+    if len(freq) > 2:
+        delay = -np.gradient(phase, 2 * np.pi * freq)
+    return {
+        'frequency': freq,
+        'h1': h1,
+        'h2': h2,
+        'coherence': np.nan_to_num(coherence),
+        'magnitude_db': 20 * np.log10(np.abs(h1) + 1e-30),
+        'phase_deg': np.degrees(phase),
+        'group_delay': delay,
+    }
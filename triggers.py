@@ -0,0 +1,218 @@
+# -*- coding: utf-8 -*-
+"""
+Live triggers.
+
+A TriggerThread follows the acquisition ring on its own thread and runs
+every armed trigger over each new chunk; a trigger's scan() returns the
+absolute sample indices where it fired and keeps whatever state it needs
+to catch events that straddle two chunks. Besides edges, triggers match a
+bit pattern in the sliced stream or run a decoder stack incrementally and
+fire on decoded bytes or decoder errors.
+"""
+
+from threading import Event, Thread
+
+import numpy as np
+
+import acquire
+import decoders
+
+
+class EdgeTrigger:
+    """Crossings of a level on the raw samples"""
+
+    name = 'edge'
+
+    def __init__(self, level, slope='rising'):
+        self.level = level
+        self.slope = slope
+        self.reset()
+
+    def reset(self):
+        self.last = None
+
+    def scan(self, start, data):
+        if not len(data):
+            return []
+        above = data >= self.level
+        prev = np.empty_like(above)
+        prev[0] = above[0] if self.last is None else self.last
+        prev[1:] = above[:-1]
+        self.last = above[-1]
+        hit = above & ~prev if self.slope == 'rising' else prev & ~above
+        return (start + np.flatnonzero(hit)).tolist()
+
+
+class TriggerThread:
+    """Runs triggers over the live stream, calling callback(index, name) on each hit"""
+
+    def __init__(self, ring, triggers, callback, holdoff=0):
+        self.ring = ring
+        self.triggers = list(triggers)
+        self.callback = callback
+        self.holdoff = holdoff
+        self.stopping = Event()
+        self.thread = Thread(target=self._run, daemon=True)
+        self.thread.start()
+
+    def _run(self):
+        armed = 0
+        for start, data, lost in acquire.follow(self.ring, self.ring.head, self.stopping):
+            for trig in self.triggers:
+                if lost:
+                    trig.reset()
+                for index in trig.scan(start, data):
+                    if index >= armed:
+                        self.callback(index, trig.name)
+                        armed = index + self.holdoff
+
+    def stop(self):
+        self.stopping.set()
+        self.thread.join()
+        for trig in self.triggers:
+            close = getattr(trig, 'close', None)  # triggers holding decoder stacks
+            if close is not None:
+                close()
+
+
+class PatternTrigger:
+    """A bit pattern ('1', '0', 'x' for don't care) in the sliced stream
+
+    Runs between edges are converted to bits with the nominal bit period; bits
+    of a run still in progress are released as soon as they are certain, so
+    a pattern is found one bit period after its last bit at most.
+    """
+
+    name = 'pattern'
+
+    def __init__(self, pattern, threshold, bit):
+        pattern = pattern.replace(' ', '').lower()
+        if not pattern or set(pattern) - set('01x'):
+            raise ValueError("pattern must be made of 0, 1 and x")
+        self.want = np.array([c == '1' for c in pattern])
+        self.care = np.array([c != 'x' for c in pattern])
+        self.threshold = threshold
+        self.bit = float(bit)
+        self.reset()
+
+    def reset(self):
+        self.level = None
+        self.run_start = 0
+        self.emitted = 0
+        self.history = np.empty(0, bool)
+        self.history_at = np.empty(0, np.int64)
+
+    def _bits(self, starts, ends, levels, closed):
+        # bits in every run, minus what was released earlier from the first one
+        length = (ends - starts) / self.bit
+        total = np.where(closed, np.maximum(1, np.round(length)), np.floor(length - 0.5)).astype(np.int64)
+        total = np.maximum(total, 0)
+        skip = np.zeros(len(total), np.int64)
+        skip[0] = self.emitted
+        count = np.maximum(total - skip, 0)
+        self.emitted = int(max(total[-1], skip[-1]))
+        bits = np.repeat(levels, count)
+        first = np.cumsum(count) - count
+        k = np.arange(len(bits)) - np.repeat(first, count) + np.repeat(skip, count)
+        at = (np.repeat(starts, count) + (k + 1) * self.bit).astype(np.int64)
+        return bits, at
+
+    def scan(self, start, data):
+        if not len(data):
+            return []
+        logic = data >= self.threshold
+        if self.level is None:
+            self.level, self.run_start = bool(logic[0]), start
+        edges = start + np.flatnonzero(logic != np.concatenate(([self.level], logic[:-1])))
+        starts = np.concatenate(([self.run_start], edges))
+        ends = np.concatenate((edges, [start + len(data)]))
+        levels = np.empty(len(starts), bool)
+        levels[0] = self.level
+        levels[1:] = logic[edges - start]
+        closed = np.ones(len(starts), bool)
+        closed[-1] = False
+        bits, at = self._bits(starts, ends, levels, closed)
+        if len(edges):
+            self.level, self.run_start = bool(levels[-1]), int(edges[-1])
+        bits = np.concatenate((self.history, bits))
+        at = np.concatenate((self.history_at, at))
+        m = len(self.want)
+        keep = max(len(bits) - m + 1, 0)
+        self.history, self.history_at = bits[keep:], at[keep:]
+        if len(bits) < m:
+            return []
+        win = np.lib.stride_tricks.sliding_window_view(bits, m)
+        hit = np.flatnonzero(np.all((win == self.want) | ~self.care, axis=1))
+        return at[hit + m - 1].tolist()
+
+
+class StackTrigger:
+    """Fires on annotations of a decoder stack run incrementally over the stream
+
+    match(annotations) returns the annotations (or their end indices) to fire
+    on; decoders count samples from the first chunk they see, so indices are
+    shifted back to absolute ones here.
+    """
+
+    def __init__(self, build, match, name):
+        self.build = build
+        self.match = match
+        self.name = name
+        self.stack = None
+        self.reset()
+
+    def reset(self):
+        self.close()
+        self.stack = self.build()
+        self.base = None
+        reset = getattr(self.match, 'reset', None)  # matches must not span a gap
+        if reset is not None:
+            reset()
+
+    def close(self):
+        if self.stack is not None:
+            self.stack.close()
+            self.stack = None
+
+    def scan(self, start, data):
+        if self.base is None:
+            self.base = start
+        found = self.stack.feed(data)
+        if not len(found):
+            return []
+        return (self.base + np.asarray(self.match(found))).tolist()
+
+
+class ByteSequence:
+    """Matcher for StackTrigger: a run of consecutive decoded byte values"""
+
+    def __init__(self, values):
+        self.values = np.asarray(values, np.int64)
+        self.reset()
+
+    def reset(self):
+        self.tail = np.empty(0, np.int64)
+        self.tail_end = np.empty(0, np.int64)
+
+    def __call__(self, found):
+        found = found[found['kind'] == decoders.KIND_BYTE]
+        values = np.concatenate((self.tail, found['value']))
+        ends = np.concatenate((self.tail_end, found['end']))
+        m = len(self.values)
+        keep = max(len(values) - m + 1, 0)
+        self.tail, self.tail_end = values[keep:], ends[keep:]
+        if len(values) < m:
+            return []
+        win = np.lib.stride_tricks.sliding_window_view(values, m)
+        return ends[np.flatnonzero(np.all(win == self.values, axis=1)) + m - 1]
+
+
+def decoder_errors(found):
+    """Matcher for StackTrigger: every annotation flagged as an error"""
+    return found['end'][(found['flags'] & decoders.FLAG_ERROR) != 0]
+
+
+def parse_bytes(text):
+    """'7E 01 ff' or '7e01ff' to a list of byte values"""
+    text = text.replace(' ', '').replace(',', '')
+    return list(bytes.fromhex(text))
@@ -0,0 +1,29 @@
+# -*- coding: utf-8 -*-
+"""
+Chunked thread-pool helpers for capture-wide numpy work.
+
+numpy releases the GIL inside its kernels, so splitting a capture into
+large chunks and mapping them over a thread pool scales across cores
+without copying the sample buffer.
+"""
+
+import os
+from concurrent.futures import ThreadPoolExecutor
+
+CHUNK = 1 << 20
+WORKERS = os.cpu_count() or 1
+
+
+def chunk_bounds(n, size=CHUNK):
+    """Split range(n) into (start, stop) pairs of at most size"""
+    size = max(1, int(size))
+    return [(s, min(s + size, n)) for s in range(0, n, size)]
+
+
+def map_chunks(fn, n, size=CHUNK, workers=WORKERS):
+    """Call fn(start, stop) for every chunk of range(n), results in order"""
+    bounds = chunk_bounds(n, size)
+    if len(bounds) <= 1 or workers <= 1:
+        return [fn(s, e) for s, e in bounds]
+    with ThreadPoolExecutor(max_workers=min(workers, len(bounds))) as pool:
+        return list(pool.map(lambda b: fn(*b), bounds))